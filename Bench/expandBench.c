@@ -0,0 +1,164 @@
+/*******
+ * Dillon Welch
+ *
+ * Expansion benchmark:
+ *    Times expandToken against the old expansion loop (preprocess repeated
+ *    up to MAX_SUBSTITUTION_LEVEL times, a fresh buffer per pass) on
+ *    tokens with deeply nested substitutions.
+ *
+ *    Usage: expandBench [iterations]
+ *******/
+
+#include "../expand.h"
+#include "../varSet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OLD_MAX_LENGTH 500   // The old fixed buffer size
+
+static VarSet* varList;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * oldPreprocess:
+ *    One substitution pass, as techShell.c used to do it.
+ ***/
+static char* oldPreprocess(char* token, int *changeFlag)
+{
+    *changeFlag = 0;
+    char *response = malloc((OLD_MAX_LENGTH+1)*sizeof(char));
+    char *responseEnd = response + OLD_MAX_LENGTH;
+    char *currResponse, *curr, *start;
+
+    start = NULL;
+    for (currResponse = response, curr = token; *curr != '\0'; curr++)
+    {
+        if (*curr == '$')
+        {
+            if (start == NULL)
+            {
+                *changeFlag = 1;
+                start = curr;
+            }
+            else
+            {
+                char temp = *curr;
+                *curr = '\0';
+                VarEntry* match = findInSet(varList, start+1);
+                *curr = temp;
+                if (match != NULL)
+                {
+                    char* copy;
+                    for (copy = match->value; *copy != '\0' && currResponse < responseEnd;
+                            copy++, currResponse++)
+                    {
+                        *currResponse = *copy;
+                    }
+                }
+                start = NULL;
+            }
+        }
+        else if (start == NULL && currResponse < responseEnd)
+        {
+            *currResponse = *curr;
+            currResponse++;
+        }
+    }
+    *currResponse = '\0';
+    return response;
+}
+
+/***
+ * oldExpand:
+ *    The old processLine loop around preprocess.
+ ***/
+static char* oldExpand(char* token)
+{
+    int changeFlag = 1;
+    int count = 1;
+    char* expanded = oldPreprocess(token, &changeFlag);
+    while (changeFlag && count++ < MAX_SUBSTITUTION_LEVEL)
+    {
+        char* previous = expanded;
+        expanded = oldPreprocess(previous, &changeFlag);
+        free(previous);
+    }
+    return expanded;
+}
+
+static void run(const char* label, char* token, long iterations)
+{
+    char* a = oldExpand(token);
+    char* b = expandToken(varList, token, NULL);
+    if (strcmp(a, b) != 0)
+    {
+        fprintf(stderr, "%s: results differ!\n  old: %s\n  new: %s\n", label, a, b);
+        exit(1);
+    }
+    free(a);
+    free(b);
+
+    long i;
+    double start = now();
+    for (i = 0; i < iterations; i++) free(oldExpand(token));
+    double oldTime = now() - start;
+
+    start = now();
+    for (i = 0; i < iterations; i++) free(expandToken(varList, token, NULL));
+    double newTime = now() - start;
+
+    printf("%-24s %10.0f %10.0f %8.1fx\n", label, oldTime * 1e9 / iterations,
+           newTime * 1e9 / iterations, oldTime / newTime);
+}
+
+int main(int argc, char *argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 100000;
+    char name[32], value[64];
+    int i;
+
+    varList = createVarSet();
+
+    // A chain: n0 = "x", nK = "<$n(K-1)$>"  (nesting 9 levels deep)
+    addToSet(varList, "n0", "x", 0);
+    for (i = 1; i < MAX_SUBSTITUTION_LEVEL; i++)
+    {
+        snprintf(name, sizeof(name), "n%d", i);
+        snprintf(value, sizeof(value), "<$n%d$>", i - 1);
+        addToSet(varList, name, value, 0);
+    }
+
+    // A tree: tK = "$t(K-1)$-$t(K-1)$" (doubles each level)
+    addToSet(varList, "t0", "ab", 0);
+    for (i = 1; i < 6; i++)
+    {
+        snprintf(name, sizeof(name), "t%d", i);
+        snprintf(value, sizeof(value), "$t%d$-$t%d$", i - 1, i - 1);
+        addToSet(varList, name, value, 0);
+    }
+
+    // Self reference (runs into the level cap)
+    addToSet(varList, "rec", "X$rec$", 0);
+
+    char deepToken[] = "Hi $n9$ there";
+    char manyToken[] = "$n9$ $n8$ $n7$ $n6$ $n5$ $n4$ $n3$ $n2$ $n1$ $n0$";
+    char treeToken[] = "$t5$";
+    char plainToken[] = "no variables in this token at all";
+
+    printf("%-24s %10s %10s %9s\n", "token", "old ns", "new ns", "speedup");
+    run("nested 9 deep", deepToken, iterations);
+    run("ten nested refs", manyToken, iterations);
+    run("tree 5 deep", treeToken, iterations);
+    run("no substitution", plainToken, iterations);
+
+    freeVarSet(varList);
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*******
+ * Dillon Welch
+ *
+ * Fast path benchmark:
+ *    Times the commands the shell can run in-process (see fastPath.h) -
+ *    echo, cat, true, and echo piped into cat - with the fast path on and
+ *    off (SET FASTPATH 0).  Reports microseconds per command, and checks
+ *    that both ways print exactly the same thing.
+ *
+ *    Usage: fastPathBench [commands] [shell]
+ *******/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * writeScript:
+ *    A script that runs line count times (after turning the fast path off
+ *    if it is not to be used).
+ ***/
+static void writeScript(const char* path, const char* line, int count, int fast)
+{
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    if (!fast) fprintf(out, "SET FASTPATH 0\n");
+    int i;
+    for (i = 0; i < count; i++) fprintf(out, "%s\n", line);
+    fclose(out);
+}
+
+/***
+ * runScript:
+ *    Runs the shell on the script, with its output going to output.
+ *    Returns the seconds it took.
+ ***/
+static double runScript(const char* shell, const char* script, const char* output)
+{
+    char command[512];
+    snprintf(command, sizeof(command), "%s %s > %s", shell, script, output);
+    double start = now();
+    if (system(command) != 0) exit(1);
+    return now() - start;
+}
+
+/***
+ * sameFiles:
+ *    Whether the two files have the same contents.
+ ***/
+static int sameFiles(const char* a, const char* b)
+{
+    char command[512];
+    snprintf(command, sizeof(command), "cmp -s %s %s", a, b);
+    return system(command) == 0;
+}
+
+/***
+ * timeCommand:
+ *    Microseconds per run of line (the shell's own start up is timed
+ *    separately and taken out).
+ ***/
+static double timeCommand(const char* shell, const char* dir, const char* line, int count, int fast)
+{
+    char script[256];
+    char output[256];
+    snprintf(script, sizeof(script), "%s/script", dir);
+    snprintf(output, sizeof(output), "%s/%s.out", dir, fast ? "fast" : "launched");
+
+    writeScript(script, line, 0, fast);
+    double setup = runScript(shell, script, output);
+
+    writeScript(script, line, count, fast);
+    return (runScript(shell, script, output) - setup) * 1e6 / count;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 500;
+    const char* shell = argc > 2 ? argv[2] : "./techShell";
+
+    char dir[] = "/tmp/fastPathBenchXXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    char data[256];
+    snprintf(data, sizeof(data), "%s/data", dir);
+    FILE* out = fopen(data, "w");
+    int i;
+    for (i = 0; i < 100; i++) fprintf(out, "line %d of the file cat prints\n", i);
+    fclose(out);
+
+    char catLine[300];
+    snprintf(catLine, sizeof(catLine), "cat %s", data);
+    const char* lines[] = { "echo \"========\"", catLine, "true", "echo piped | cat", NULL };
+    const char* names[] = { "echo", "cat (4 KB)", "true", "echo | cat", NULL };
+
+    char fastOut[256];
+    char launchedOut[256];
+    snprintf(fastOut, sizeof(fastOut), "%s/fast.out", dir);
+    snprintf(launchedOut, sizeof(launchedOut), "%s/launched.out", dir);
+
+    printf("%-12s %12s %12s %9s %s\n", "command", "launched us", "fast us", "speedup", "output");
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        double launched = timeCommand(shell, dir, lines[i], count, 0);
+        double fast = timeCommand(shell, dir, lines[i], count, 1);
+        printf("%-12s %12.1f %12.1f %8.1fx %s\n", names[i], launched, fast, launched / fast,
+               sameFiles(fastOut, launchedOut) ? "same" : "DIFFERENT");
+    }
+
+    unlink(fastOut);
+    unlink(launchedOut);
+    unlink(data);
+    char script[256];
+    snprintf(script, sizeof(script), "%s/script", dir);
+    unlink(script);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*******
+ * Dillon Welch
+ *
+ * Line benchmark:
+ *    Writes a script of 1 MB single-line commands (SET with a long quoted
+ *    argument list, then a SET that expands it twice), and
+ *      - reads it with the line reader and with getline, reporting MB/s,
+ *      - runs the shell on it, reporting MB/s, and checks (from what LIST
+ *        prints at the end) that no line or expansion was cut short.
+ *
+ *    Usage: lineBench [lines] [megabytes per line] [shell]
+ *******/
+
+#include "../lineReader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * writeScript:
+ *    Writes the script to path, returns its size in bytes.
+ ***/
+static size_t writeScript(const char* path, int lines, size_t lineSize)
+{
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    char* arg = malloc(lineSize + 1);
+    size_t i;
+    srand(42);
+    for (i = 0; i < lineSize; i++) arg[i] = (rand() % 8 == 0) ? ' ' : 'a' + rand() % 26;
+    arg[lineSize] = '\0';
+
+    int l;
+    for (l = 0; l < lines; l++)
+    {
+        fprintf(out, "SET big \"%s\"\n", arg);
+        fprintf(out, "SET twice \"$big$ $big$\"\n");
+    }
+    fprintf(out, "LIST\n");
+
+    size_t size = ftell(out);
+    fclose(out);
+    free(arg);
+    return size;
+}
+
+int main(int argc, char *argv[])
+{
+    int lines = argc > 1 ? atoi(argv[1]) : 8;
+    double megabytes = argc > 2 ? atof(argv[2]) : 1;
+    const char* shell = argc > 3 ? argv[3] : "./techShell";
+    size_t lineSize = (size_t) (megabytes * 1024 * 1024);
+
+    char dir[] = "/tmp/lineBenchXXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    char script[64], command[256];
+    snprintf(script, sizeof(script), "%s/script", dir);
+    double bytes = writeScript(script, lines, lineSize) / (1024.0 * 1024);
+
+    printf("%d lines of %.1f MB\n", lines * 2 + 1, megabytes);
+    printf("%-12s %10s %10s\n", "reader", "lines", "MB/s");
+
+    // The line reader
+    int fd = open(script, O_RDONLY);
+    LineReader reader;
+    initLineReader(&reader, fd);
+    long count = 0;
+    double start = now();
+    while (readLine(&reader, NULL) != NULL) count++;
+    printf("%-12s %10ld %10.1f\n", "lineReader", count, bytes / (now() - start));
+    freeLineReader(&reader);
+    close(fd);
+
+    // getline (stdio)
+    FILE* in = fopen(script, "r");
+    char* line = NULL;
+    size_t size = 0;
+    count = 0;
+    start = now();
+    while (getline(&line, &size, in) != -1) count++;
+    printf("%-12s %10ld %10.1f\n", "getline", count, bytes / (now() - start));
+    free(line);
+    fclose(in);
+
+    // The whole shell (counting what LIST prints)
+    snprintf(command, sizeof(command), "%s %s", shell, script);
+    start = now();
+    in = popen(command, "r");
+    char block[65536];
+    size_t n;
+    long listed = 0;
+    while ((n = fread(block, 1, sizeof(block), in)) > 0) listed += n;
+    if (pclose(in) != 0)
+    {
+        fprintf(stderr, "%s failed\n", command);
+        return 1;
+    }
+    printf("%-12s %10d %10.1f\n", "shell", lines * 2 + 1, bytes / (now() - start));
+
+    // big (the line) and twice (its expansion) must be listed in full
+    long expected = lineSize * 3 + 1;
+    if (listed < expected)
+    {
+        fprintf(stderr, "LIST printed %ld bytes, expected at least %ld: truncated!\n",
+                listed, expected);
+        return 1;
+    }
+
+    unlink(script);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,292 @@
+/*******
+ * Dillon Welch
+ *
+ * Micro benchmark:
+ *    Times the parsing side of the shell on its own, with nothing launched:
+ *       startToken     startToken/getNextToken over a corpus of script lines
+ *       nextToken      initTokenizer/nextToken over the same lines (copied
+ *                      first, as they are tokenized in place)
+ *       preprocess     tokens with no, one, several and nested $var$s
+ *       preprocess+SET the same, with a variable SET every 16 tokens (so
+ *                      memoized expansions keep going stale)
+ *       addToSet       setting 1000 variables
+ *       findInSet hit  looking up 1000 variables that are set
+ *       findInSet miss ... and 1000 that are not
+ *    Each is warmed up, then run a number of times; the best and median
+ *    times are reported as ns per operation (a token, or a variable) and,
+ *    for the tokenizer, ns per byte of the corpus.  Every run must get the
+ *    same checksum of what it produced.
+ *
+ *    Usage: microBench [repeats] [warmup]
+ *******/
+
+#include "../tokenizer.h"
+#include "../varSet.h"
+#include "../expand.h"
+#include "../arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LINES 20000
+#define VARS 1000
+#define TOKENS 20000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The corpora (made once, the same every time)
+static char* lines[LINES];     // Script lines
+static size_t lineBytes = 0;   // ... all together
+static char* scratch;          // A line to tokenize in place
+static char* tokens[TOKENS];   // Tokens to expand
+static char names[2 * VARS][16];   // Set (the first VARS) and never set (the rest)
+static VarSet* set;
+static Arena arena;
+
+/***
+ * makeCorpora:
+ *    The lines, tokens and variables the benchmarks use.
+ ***/
+static void makeCorpora()
+{
+    static const char* words[] = { "echo", "cat", "SET", "grep", "-n", "sort", "$word$", "file.txt", "x" };
+    static const char* ops[] = { "|", ";", "<", ">", ">>", ">&" };
+    srand(42);
+
+    size_t longest = 0;
+    int i;
+    for (i = 0; i < LINES; i++)
+    {
+        char line[1024];
+        int length = 0;
+        int count = 2 + rand() % 12;
+        int w;
+        for (w = 0; w < count; w++)
+        {
+            int kind = rand() % 10;
+            if (kind < 6) length += sprintf(line + length, "%s ", words[rand() % 9]);
+            else if (kind < 8) length += sprintf(line + length, "\"a quoted $v%d$ argument\" ", rand() % VARS);
+            else if (kind < 9) length += sprintf(line + length, "'single %d' ", rand());
+            else length += sprintf(line + length, "%s ", ops[rand() % 6]);
+        }
+        if (rand() % 4 == 0) length += sprintf(line + length, "# a comment");
+        line[length++] = '\n';
+        line[length] = '\0';
+        lines[i] = strdup(line);
+        lineBytes += length;
+        if ((size_t) length > longest) longest = length;
+    }
+    scratch = malloc(longest + 1);
+
+    set = createVarSet();
+    for (i = 0; i < 2 * VARS; i++) snprintf(names[i], sizeof(names[i]), "v%d", i);
+    for (i = 0; i < VARS; i++)
+    {
+        char value[64];
+        if (i % 10 == 0 && i >= 10) snprintf(value, sizeof(value), "n$v%d$n", i - 10);   // Nested (v20 holds $v10$, ...)
+        else snprintf(value, sizeof(value), "value %d", i);
+        addToSet(set, names[i], value, SINGLE_QUOTE);
+    }
+
+    for (i = 0; i < TOKENS; i++)
+    {
+        char token[128];
+        int v = rand() % VARS;
+        switch (rand() % 4)
+        {
+        case 0:
+            snprintf(token, sizeof(token), "plain-%d", i);
+            break;
+        case 1:
+            snprintf(token, sizeof(token), "$v%d$", v);
+            break;
+        case 2:
+            snprintf(token, sizeof(token), "a $v%d$ b $v%d$ c $v%d$", v, (v + 1) % VARS, (v + 2) % VARS);
+            break;
+        default:
+            snprintf(token, sizeof(token), "deep $v%d$", 900 + 10 * (rand() % 10));
+            break;
+        }
+        tokens[i] = strdup(token);
+    }
+    initArena(&arena);
+}
+
+static unsigned long mix(unsigned long sum, unsigned long value)
+{
+    return sum * 31 + value;
+}
+
+/***
+ * The benchmarks: each does one pass, adds what it got to sum, and
+ * returns the number of operations.
+ ***/
+static long runStartToken(unsigned long* sum)
+{
+    long count = 0;
+    int i;
+    for (i = 0; i < LINES; i++)
+    {
+        startToken(lines[i]);
+        aToken tok;
+        for (tok = getNextToken(); tok.type != EOL && tok.type != ERROR; tok = getNextToken(), count++)
+        {
+            *sum = mix(*sum, tok.type);
+        }
+    }
+    return count;
+}
+
+static long runNextToken(unsigned long* sum)
+{
+    long count = 0;
+    int i;
+    for (i = 0; i < LINES; i++)
+    {
+        strcpy(scratch, lines[i]);
+        Tokenizer tokenizer;
+        initTokenizer(&tokenizer, scratch);
+        aToken tok;
+        for (tok = nextToken(&tokenizer); tok.type != EOL && tok.type != ERROR; tok = nextToken(&tokenizer), count++)
+        {
+            *sum = mix(*sum, tok.type);
+        }
+        freeTokenizer(&tokenizer);
+    }
+    return count;
+}
+
+static long runPreprocess(unsigned long* sum)
+{
+    int i;
+    for (i = 0; i < TOKENS; i++)
+    {
+        int changeFlag;
+        char* expanded = preprocess(set, tokens[i], &changeFlag, &arena);
+        *sum = mix(*sum, strlen(expanded) + changeFlag);
+        if (i % 64 == 63) resetArena(&arena);   // (As at the end of a statement)
+    }
+    resetArena(&arena);
+    return TOKENS;
+}
+
+static long runPreprocessSet(unsigned long* sum)
+{
+    int i;
+    for (i = 0; i < TOKENS; i++)
+    {
+        if (i % 16 == 15) addToSet(set, names[VARS - 1], "changed", SINGLE_QUOTE);
+        int changeFlag;
+        char* expanded = preprocess(set, tokens[i], &changeFlag, &arena);
+        *sum = mix(*sum, strlen(expanded) + changeFlag);
+        if (i % 64 == 63) resetArena(&arena);
+    }
+    resetArena(&arena);
+    return TOKENS;
+}
+
+static long runAddToSet(unsigned long* sum)
+{
+    int i;
+    for (i = 0; i < VARS; i++)
+    {
+        // (The same values they had, so every pass is alike)
+        char value[64];
+        if (i % 10 == 0 && i >= 10) snprintf(value, sizeof(value), "n$v%d$n", i - 10);
+        else snprintf(value, sizeof(value), "value %d", i);
+        addToSet(set, names[i], value, SINGLE_QUOTE);
+    }
+    *sum = mix(*sum, VARS);
+    return VARS;
+}
+
+static long runFindHit(unsigned long* sum)
+{
+    int i;
+    for (i = 0; i < VARS; i++) *sum = mix(*sum, findInSet(set, names[(i * 7919) % VARS]) != NULL);
+    return VARS;
+}
+
+static long runFindMiss(unsigned long* sum)
+{
+    int i;
+    for (i = 0; i < VARS; i++) *sum = mix(*sum, findInSet(set, names[VARS + (i * 7919) % VARS]) != NULL);
+    return VARS;
+}
+
+static int compareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/***
+ * measure:
+ *    Warms up the benchmark, then times it repeats times and prints its line.
+ *    Returns 0 if a run did not get the same checksum as the others.
+ ***/
+static int measure(const char* name, long (*run)(unsigned long*), size_t bytes, int repeats, int warmup)
+{
+    unsigned long expected = 0;
+    long ops = 0;
+    int i;
+    for (i = 0; i < warmup; i++)
+    {
+        expected = 0;
+        ops = run(&expected);
+    }
+
+    double* times = malloc(repeats * sizeof(double));
+    for (i = 0; i < repeats; i++)
+    {
+        unsigned long sum = 0;
+        double start = now();
+        run(&sum);
+        times[i] = now() - start;
+        if (sum != expected)
+        {
+            fprintf(stderr, "%s: run %d got a different result!\n", name, i);
+            free(times);
+            return 0;
+        }
+    }
+    qsort(times, repeats, sizeof(double), compareDoubles);
+
+    double best = times[0] * 1e9;
+    double median = times[repeats / 2] * 1e9;
+    printf("%-16s %10ld %12.1f %12.1f", name, ops, best / ops, median / ops);
+    if (bytes > 0) printf(" %10.2f", median / bytes);
+    printf("\n");
+    free(times);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int repeats = argc > 1 ? atoi(argv[1]) : 15;
+    int warmup = argc > 2 ? atoi(argv[2]) : 3;
+    if (repeats < 1) repeats = 1;
+    if (warmup < 1) warmup = 1;
+
+    makeCorpora();
+    printf("%d lines (%zu bytes), %d tokens, %d variables; %d runs after %d warm up\n",
+           LINES, lineBytes, TOKENS, VARS, repeats, warmup);
+    printf("%-16s %10s %12s %12s %10s\n", "benchmark", "ops/run", "best ns/op", "median ns/op", "ns/byte");
+
+    int ok = 1;
+    ok &= measure("startToken", runStartToken, lineBytes, repeats, warmup);
+    ok &= measure("nextToken", runNextToken, lineBytes, repeats, warmup);
+    ok &= measure("preprocess", runPreprocess, 0, repeats, warmup);
+    ok &= measure("preprocess+SET", runPreprocessSet, 0, repeats, warmup);
+    ok &= measure("addToSet", runAddToSet, 0, repeats, warmup);
+    ok &= measure("findInSet hit", runFindHit, 0, repeats, warmup);
+    ok &= measure("findInSet miss", runFindMiss, 0, repeats, warmup);
+    return ok ? 0 : 1;
+}
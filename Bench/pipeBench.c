@@ -0,0 +1,145 @@
+/*******
+ * Dillon Welch
+ *
+ * Pipe benchmark:
+ *    Pushes gigabytes through an in-shell cat (see fastPath.h), with the
+ *    fast path on (the kernel moves the data: splice/sendfile) and off
+ *    (cat is launched and copies it), and reports GB/s for:
+ *       file -> null:   cat < file > /dev/null
+ *       file -> file:   cat file > copy
+ *       file -> pipe:   cat < file | wc -c
+ *       pipe -> null:   head -c N file | cat > /dev/null
+ *       pipe -> pipe:   head -c N file | cat | wc -c
+ *    (wc and head copy the data themselves either way, so those rows only
+ *    show what is saved in cat.)  The copy's size and the byte counts wc
+ *    prints are checked.
+ *
+ *    Usage: pipeBench [GB] [shell]
+ *******/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * runLine:
+ *    Runs the one line script (fast path on or off) and returns the
+ *    seconds it took.  The number the script printed (if any) is put in
+ *    printed.
+ ***/
+static double runLine(const char* shell, const char* script, const char* line, int fast, long long* printed)
+{
+    FILE* out = fopen(script, "w");
+    if (out == NULL)
+    {
+        perror(script);
+        exit(1);
+    }
+    if (!fast) fprintf(out, "SET FASTPATH 0\n");
+    fprintf(out, "%s\n", line);
+    fclose(out);
+
+    char command[512];
+    snprintf(command, sizeof(command), "%s %s", shell, script);
+    double start = now();
+    FILE* in = popen(command, "r");
+    *printed = -1;
+    if (fscanf(in, "%lld", printed) != 1) *printed = -1;
+    while (fgetc(in) != EOF);
+    pclose(in);
+    return now() - start;
+}
+
+/***
+ * makeFile:
+ *    A file of bytes bytes (written once, through the page cache).
+ ***/
+static void makeFile(const char* path, long long bytes)
+{
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    static char block[1 << 20];
+    memset(block, 'x', sizeof(block));
+    long long left;
+    for (left = bytes; left > 0; left -= sizeof(block))
+    {
+        fwrite(block, 1, left < (long long) sizeof(block) ? left : sizeof(block), out);
+    }
+    fclose(out);
+}
+
+int main(int argc, char *argv[])
+{
+    double gigabytes = argc > 1 ? atof(argv[1]) : 2;
+    const char* shell = argc > 2 ? argv[2] : "./techShell";
+    long long bytes = (long long) (gigabytes * 1024 * 1024 * 1024);
+
+    char dir[] = "/tmp/pipeBenchXXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    char script[256];
+    char data[256];
+    char copy[256];
+    snprintf(script, sizeof(script), "%s/script", dir);
+    snprintf(data, sizeof(data), "%s/data", dir);
+    snprintf(copy, sizeof(copy), "%s/copy", dir);
+    makeFile(data, bytes);
+
+    char lines[5][1024];
+    snprintf(lines[0], sizeof(lines[0]), "cat < %s > /dev/null", data);
+    snprintf(lines[1], sizeof(lines[1]), "cat %s > %s", data, copy);
+    snprintf(lines[2], sizeof(lines[2]), "cat < %s | wc -c", data);
+    snprintf(lines[3], sizeof(lines[3]), "head -c %lld %s | cat > /dev/null", bytes, data);
+    snprintf(lines[4], sizeof(lines[4]), "head -c %lld %s | cat | wc -c", bytes, data);
+    const char* names[] = { "file->null", "file->file", "file->pipe", "pipe->null", "pipe->pipe" };
+    enum { NOTHING, COPY, COUNT } checks[] = { NOTHING, COPY, COUNT, NOTHING, COUNT };
+
+    printf("%.1f GB each\n", bytes / (1024.0 * 1024 * 1024));
+    printf("%-12s %14s %14s %9s\n", "cat", "launched GB/s", "in-shell GB/s", "speedup");
+    int i;
+    for (i = 0; i < 5; i++)
+    {
+        double rate[2];
+        int fast;
+        for (fast = 0; fast <= 1; fast++)
+        {
+            unlink(copy);
+            long long printed;
+            double seconds = runLine(shell, script, lines[i], fast, &printed);
+            struct stat info;
+            long long moved = bytes;
+            if (checks[i] == COPY) moved = stat(copy, &info) == 0 ? info.st_size : -1;
+            if (checks[i] == COUNT) moved = printed;
+            if (moved != bytes)
+            {
+                fprintf(stderr, "%s: moved %lld bytes, not %lld\n", names[i], moved, bytes);
+                return 1;
+            }
+            rate[fast] = bytes / seconds / (1024.0 * 1024 * 1024);
+        }
+        printf("%-12s %14.2f %14.2f %8.1fx\n", names[i], rate[0], rate[1], rate[1] / rate[0]);
+    }
+
+    unlink(copy);
+    unlink(data);
+    unlink(script);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*******
+ * Dillon Welch
+ *
+ * Pipe size benchmark:
+ *    Pushes gigabytes through a 3 stage pipeline of launched commands
+ *
+ *       head -c N /dev/zero | cat | wc -c
+ *
+ *    with the shell's pipes at different sizes (SET PIPESIZE), and reports
+ *    GB/s for each.  (The fast path is turned off, so cat is a process of
+ *    its own too.)  The byte count wc prints is checked.
+ *
+ *    Usage: pipeSizeBench [GB] [shell]
+ *******/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * runPipeline:
+ *    Runs the pipeline with pipes of the given size (NULL for the
+ *    default).  Returns the seconds it took; the count wc printed is put
+ *    in counted.
+ ***/
+static double runPipeline(const char* shell, const char* script, const char* size, long long bytes, long long* counted)
+{
+    FILE* out = fopen(script, "w");
+    if (out == NULL)
+    {
+        perror(script);
+        exit(1);
+    }
+    fprintf(out, "SET FASTPATH 0\n");
+    if (size != NULL) fprintf(out, "SET PIPESIZE %s\n", size);
+    fprintf(out, "head -c %lld /dev/zero | cat | wc -c\n", bytes);
+    fclose(out);
+
+    char command[512];
+    snprintf(command, sizeof(command), "%s %s", shell, script);
+    double start = now();
+    FILE* in = popen(command, "r");
+    if (fscanf(in, "%lld", counted) != 1) *counted = -1;
+    while (fgetc(in) != EOF);
+    pclose(in);
+    return now() - start;
+}
+
+int main(int argc, char *argv[])
+{
+    double gigabytes = argc > 1 ? atof(argv[1]) : 10;
+    const char* shell = argc > 2 ? argv[2] : "./techShell";
+    long long bytes = (long long) (gigabytes * 1024 * 1024 * 1024);
+    static const char* sizes[] = { NULL, "128K", "256K", "512K", "1M" };
+
+    char script[] = "/tmp/pipeSizeBenchXXXXXX";
+    int fd = mkstemp(script);
+    if (fd == -1)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    printf("%.1f GB each\n", bytes / (1024.0 * 1024 * 1024));
+    printf("%-14s %10s %8s\n", "pipe size", "GB/s", "seconds");
+    int i;
+    for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        long long counted;
+        double seconds = runPipeline(shell, script, sizes[i], bytes, &counted);
+        if (counted != bytes)
+        {
+            fprintf(stderr, "%s: wc counted %lld bytes, not %lld\n", sizes[i] == NULL ? "default" : sizes[i], counted, bytes);
+            unlink(script);
+            return 1;
+        }
+        printf("%-14s %10.2f %8.2f\n", sizes[i] == NULL ? "64K (default)" : sizes[i], bytes / seconds / (1024.0 * 1024 * 1024), seconds);
+    }
+
+    unlink(script);
+    return 0;
+}
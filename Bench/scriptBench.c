@@ -0,0 +1,126 @@
+/*******
+ * Dillon Welch
+ *
+ * Script benchmark:
+ *    Writes a large script (100 MB by default) of short builtin statements
+ *    and runs the shell on it with the script mapped and streamed
+ *    (TECHSHELL_MMAP=0), reporting for each
+ *      - the startup-to-first-command latency (until the output of the first
+ *        statement arrives), and
+ *      - the total lines per second.
+ *    The output of both runs must be the same.
+ *
+ *    Usage: scriptBench [megabytes] [shell]
+ *******/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * writeScript:
+ *    Writes about size bytes of script to path, returns the number of lines.
+ ***/
+static long writeScript(const char* path, size_t size)
+{
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    // The first statement prints something (LIST flushes it right away)
+    fprintf(out, "SET first 1 ; LIST\n");
+    long lines = 1;
+    while ((size_t) ftell(out) < size)
+    {
+        switch (lines % 4)
+        {
+        case 0:
+            fprintf(out, "SET v%ld \"value %ld $first$\"\n", lines % 64, lines);
+            break;
+        case 1:
+            fprintf(out, "# A comment line to skip over, number %ld\n", lines);
+            break;
+        case 2:
+            fprintf(out, "SET w%ld 'single $quoted$' ; SET x $v%ld$\n", lines % 16, lines % 64);
+            break;
+        default:
+            fprintf(out, "\n");
+            break;
+        }
+        lines++;
+    }
+    fprintf(out, "LIST\n");
+    lines++;
+    fclose(out);
+    return lines;
+}
+
+/***
+ * run:
+ *    Runs the shell on the script, reporting the times.
+ *    Returns a checksum of its output.
+ ***/
+static unsigned long run(const char* label, const char* command, long lines)
+{
+    double start = now();
+    FILE* in = popen(command, "r");
+    int c = fgetc(in);
+    double first = now() - start;
+
+    unsigned long sum = 0;
+    for ( ; c != EOF; c = fgetc(in)) sum = sum * 31 + c;
+    if (pclose(in) != 0)
+    {
+        fprintf(stderr, "%s failed\n", command);
+        exit(1);
+    }
+    double total = now() - start;
+    printf("%-10s %14.1f %14.0f\n", label, first * 1e6, lines / total);
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    double megabytes = argc > 1 ? atof(argv[1]) : 100;
+    const char* shell = argc > 2 ? argv[2] : "./techShell";
+
+    char dir[] = "/tmp/scriptBenchXXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    char script[64], command[256];
+    snprintf(script, sizeof(script), "%s/script", dir);
+    long lines = writeScript(script, (size_t) (megabytes * 1024 * 1024));
+    snprintf(command, sizeof(command), "%s %s", shell, script);
+
+    printf("%.0f MB script, %ld lines\n", megabytes, lines);
+    printf("%-10s %14s %14s\n", "mode", "first cmd us", "lines/s");
+
+    setenv("TECHSHELL_MMAP", "0", 1);
+    unsigned long streamed = run("streamed", command, lines);
+    setenv("TECHSHELL_MMAP", "1", 1);
+    unsigned long mapped = run("mapped", command, lines);
+
+    unlink(script);
+    rmdir(dir);
+    if (streamed != mapped)
+    {
+        fprintf(stderr, "Output differs between the modes!\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*******
+ * Dillon Welch
+ *
+ * Spawn benchmark:
+ *    Times launching a trivial command (true) from the shell while the
+ *    shell holds more and more memory (a variable of each size, plus the
+ *    script line it came from), with posix_spawn and with fork
+ *    (SET SPAWN fork).  Reports microseconds per launch against the
+ *    shell's resident size.
+ *
+ *    Usage: spawnBench [launches] [shell]
+ *******/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * writeScript:
+ *    A script that SETs a variable of megabytes MB, then runs true
+ *    launches times.
+ ***/
+static void writeScript(const char* path, int megabytes, int launches, int fork)
+{
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    size_t size = (size_t) megabytes * 1024 * 1024;
+    fprintf(out, "SET big '");
+    size_t i;
+    for (i = 0; i < size; i++) fputc('a' + i % 26, out);
+    fprintf(out, "'\n");
+    if (fork) fprintf(out, "SET SPAWN fork\n");
+    int l;
+    for (l = 0; l < launches; l++) fprintf(out, "true\n");
+    fclose(out);
+}
+
+/***
+ * rssOf:
+ *    Runs the shell on a script that SETs the variable, and returns its
+ *    peak resident size in KB (by having the shell run a command that
+ *    reads its parent's status from /proc).
+ ***/
+static long rssOf(const char* shell, const char* path, int megabytes)
+{
+    FILE* out = fopen(path, "w");
+    size_t size = (size_t) megabytes * 1024 * 1024;
+    fprintf(out, "SET big '");
+    size_t i;
+    for (i = 0; i < size; i++) fputc('a' + i % 26, out);
+    fprintf(out, "'\nsh -c 'grep VmHWM /proc/$PPID/status'\n");
+    fclose(out);
+
+    char command[256];
+    snprintf(command, sizeof(command), "%s %s", shell, path);
+    FILE* in = popen(command, "r");
+    long kb = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        if (strncmp(line, "VmHWM:", 6) == 0) kb = atol(line + 6);
+    }
+    pclose(in);
+    return kb;
+}
+
+/***
+ * timeLaunches:
+ *    Microseconds per launch of true (the SET lines are timed separately
+ *    and taken out).
+ ***/
+static double timeLaunches(const char* shell, const char* path, int megabytes, int launches, int fork)
+{
+    char command[256];
+    snprintf(command, sizeof(command), "%s %s", shell, path);
+
+    writeScript(path, megabytes, 0, fork);
+    double start = now();
+    if (system(command) != 0) exit(1);
+    double setup = now() - start;
+
+    writeScript(path, megabytes, launches, fork);
+    start = now();
+    if (system(command) != 0) exit(1);
+    return (now() - start - setup) * 1e6 / launches;
+}
+
+int main(int argc, char *argv[])
+{
+    int launches = argc > 1 ? atoi(argv[1]) : 200;
+    const char* shell = argc > 2 ? argv[2] : "./techShell";
+    static const int sizes[] = { 0, 16, 64, 256 };
+
+    char dir[] = "/tmp/spawnBenchXXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    char script[64];
+    snprintf(script, sizeof(script), "%s/script", dir);
+
+    printf("%8s %10s %12s %12s\n", "var MB", "RSS MB", "spawn us", "fork us");
+    int i;
+    for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        long rss = rssOf(shell, script, sizes[i]);
+        double spawn = timeLaunches(shell, script, sizes[i], launches, 0);
+        double fork = timeLaunches(shell, script, sizes[i], launches, 1);
+        printf("%8d %10.1f %12.1f %12.1f\n", sizes[i], rss / 1024.0, spawn, fork);
+    }
+
+    unlink(script);
+    rmdir(dir);
+    return 0;
+}
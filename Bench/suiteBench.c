@@ -0,0 +1,460 @@
+/*******
+ * Dillon Welch
+ *
+ * Suite benchmark:
+ *    Runs the shell on a fixed set of scripts, checks what each printed
+ *    against its golden output, and reports the numbers a slower hot path
+ *    would show up in.  The scripts are
+ *       shell.2, shell.3, shell.5   from Input/ (golden output in Output/ -
+ *                                   the others print paths, so they vary)
+ *       redirect.in, catTest.in     from Input/ too: the files redirect.in
+ *                                   writes (fileA, f00, fooTest) are checked
+ *                                   against Output/, then catTest.in prints them
+ *       background.in               from Input/: a background cat of a FIFO
+ *                                   must not hold up the shell (it hangs if it does)
+ *       vars        N variables set, then each one echoed
+ *       nesting     values nested 9 $var$ levels deep (the most that are
+ *                   all substituted), with the innermost changed now and then
+ *       pipeline    16 command pipelines
+ *       redirect    many small files written with >, then appended with >>
+ *       hugeline    very long lines (thousands of words each)
+ *       parallel    PARALLEL output of 200K piped into tr (more than a pipe
+ *                   holds, so it hangs if the output is not held back)
+ *    all scaled by the scale given (the sizes below are for 1); their
+ *    golden output is written along with them.
+ *
+ *    Everything is run in a scratch directory (never in the tree, so no
+ *    file a script writes is left there).  Each script is run twice: once with
+ *    TECHSHELL_STATS (see stats.h) for the throughput, the commands it
+ *    launched and its peak resident size, and once with TECHSHELL_TRACE
+ *    (see trace.h) for how long each statement took, from its parse
+ *    to its last command being reaped.  One line is printed for each, as
+ *    key=value pairs (always in the same order) so runs can be compared:
+ *       bench=vars lines=4000 seconds=0.012 lines/s=333333 forks/s=0 maxrss=1900K p50=2.1us p99=9.8us output=ok
+ *    The exit status is 1 if any output was not what it should be.
+ *
+ *    Usage: suiteBench [scale] [shell]   (run from the top of the tree)
+ *******/
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * The generated scripts: each writes the script and what it must print,
+ * and returns the number of lines in the script.
+ ***/
+static long writeVars(FILE* script, FILE* golden, int scale)
+{
+    int count = 2000 * scale;
+    int i;
+    for (i = 0; i < count; i++) fprintf(script, "SET v%d \"value %d\"\n", i, i);
+    for (i = 0; i < count; i++)
+    {
+        fprintf(script, "echo $v%d$\n", (i * 7919) % count);   // (Not in the order they were set)
+        fprintf(golden, "value %d\n", (i * 7919) % count);
+    }
+    return 2L * count;
+}
+
+static long writeNesting(FILE* script, FILE* golden, int scale)
+{
+    int levels = 9;
+    fprintf(script, "SET n0 a\n");
+    int i;
+    for (i = 1; i <= levels; i++) fprintf(script, "SET n%d '$n%d$b'\n", i, i - 1);
+    long lines = 1 + levels;
+
+    int count = 4000 * scale;
+    int version = 0;
+    for (i = 0; i < count; i++, lines++)
+    {
+        if (i % 100 == 99)
+        {
+            // A new innermost value (so no memoized expansion is still good)
+            version++;
+            fprintf(script, "SET n0 a%d\n", version);
+            lines++;
+        }
+        char inner[16];
+        snprintf(inner, sizeof(inner), version ? "a%d" : "a", version);
+        fprintf(script, "echo $n%d$ \"$n4$-$n%d$\"\n", levels, levels);
+        fprintf(golden, "%sbbbbbbbbb %sbbbb-%sbbbbbbbbb\n", inner, inner, inner);
+    }
+    return lines;
+}
+
+static long writePipeline(FILE* script, FILE* golden, int scale)
+{
+    int count = 100 * scale;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        fprintf(script, "echo line %d", i);
+        int stage;
+        for (stage = 1; stage < 16; stage++) fprintf(script, stage % 2 ? " | tr a-z A-Z" : " | cat");
+        fprintf(script, "\n");
+        fprintf(golden, "LINE %d\n", i);
+    }
+    return count;
+}
+
+static long writeRedirect(FILE* script, FILE* golden, int scale)
+{
+    int count = 500 * scale;
+    fprintf(script, "echo -n > all.txt\n");   // (Emptied, for each run)
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        fprintf(script, "echo file %d > r%d.txt\n", i, i % 50);
+        fprintf(script, "cat < r%d.txt >> all.txt\n", i % 50);
+        fprintf(golden, "file %d\n", i);
+    }
+    fprintf(script, "cat all.txt\n");
+    return 2L * count + 2;
+}
+
+static long writeHugeline(FILE* script, FILE* golden, int scale)
+{
+    int count = 50 * scale;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        fprintf(script, "echo");
+        int word;
+        for (word = 0; word < 5000; word++)
+        {
+            fprintf(script, " w%d", word + i);
+            fprintf(golden, word ? " w%d" : "w%d", word + i);
+        }
+        fprintf(script, "\n");
+        fprintf(golden, "\n");
+    }
+    return count;
+}
+
+static long writeParallel(FILE* script, FILE* golden, int scale)
+{
+    int items = 200;
+    int count = 5 * scale;
+    fprintf(script, "SET items '");
+    int i;
+    for (i = 0; i < items; i++) fprintf(script, i ? " i%d" : "i%d", i);
+    fprintf(script, "'\n");
+
+    char pad[1001];
+    memset(pad, 'x', 1000);
+    pad[1000] = '\0';
+    for (i = 0; i < count; i++)
+    {
+        fprintf(script, "PARALLEL -j 4 -v items echo $ITEM$ %s | tr a-z A-Z\n", pad);
+        int item;
+        for (item = 0; item < items; item++)
+        {
+            fprintf(golden, "I%d ", item);
+            int c;
+            for (c = 0; c < 1000; c++) fputc('X', golden);
+            fputc('\n', golden);
+        }
+    }
+    return count + 1;
+}
+
+/***
+ * countLines:
+ *    The number of lines in the file.
+ ***/
+static long countLines(const char* path)
+{
+    FILE* in = fopen(path, "r");
+    if (in == NULL) return 0;
+    long lines = 0;
+    int c;
+    while ((c = fgetc(in)) != EOF) lines += (c == '\n');
+    fclose(in);
+    return lines;
+}
+
+/***
+ * sameFiles:
+ *    Whether the two files have the same contents.
+ ***/
+static int sameFiles(const char* a, const char* b)
+{
+    FILE* first = fopen(a, "r");
+    FILE* second = fopen(b, "r");
+    int same = (first != NULL && second != NULL);
+    while (same)
+    {
+        int c = fgetc(first);
+        same = (c == fgetc(second));
+        if (c == EOF) break;
+    }
+    if (first != NULL) fclose(first);
+    if (second != NULL) fclose(second);
+    return same;
+}
+
+/***
+ * copyScript:
+ *    Copies the script, without the carriage returns of DOS line ends
+ *    (so the file names in it are the real ones).
+ ***/
+static void copyScript(const char* from, const char* to)
+{
+    FILE* in = fopen(from, "r");
+    FILE* out = fopen(to, "w");
+    if (in == NULL || out == NULL)
+    {
+        perror(in == NULL ? from : to);
+        exit(1);
+    }
+    int c;
+    while ((c = fgetc(in)) != EOF)
+    {
+        if (c != '\r') fputc(c, out);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/***
+ * runShell:
+ *    Runs the shell on the script (in dir, with the variable name set to
+ *    value), its output going to out and its errors to err.
+ *    Returns the seconds it took.
+ ***/
+static double runShell(const char* shell, const char* dir, const char* script, const char* out,
+                       const char* err, const char* name, const char* value)
+{
+    double start = now();
+    int child = fork();
+    if (child == 0)
+    {
+        if (chdir(dir) == -1) _exit(127);
+        setenv(name, value, 1);
+        int outFd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int errFd = open(err, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (outFd == -1 || errFd == -1) _exit(127);
+        dup2(outFd, 1);
+        dup2(errFd, 2);
+        execl(shell, shell, script, (char*) NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    return now() - start;
+}
+
+/***
+ * readStats:
+ *    The commands launched and the peak resident size (K), from the
+ *    counters the shell printed at exit.
+ ***/
+static void readStats(const char* err, unsigned long* launched, long* maxrss)
+{
+    *launched = 0;
+    *maxrss = 0;
+    FILE* in = fopen(err, "r");
+    if (in == NULL) return;
+    char line[1024];
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        unsigned long builtins, fast, spawned, forked;
+        if (sscanf(line, ">> Commands: %lu builtins, %lu in the shell, %lu spawned, %lu forked",
+                   &builtins, &fast, &spawned, &forked) == 4)
+        {
+            *launched = spawned + forked;
+        }
+        sscanf(line, ">> Memory: %ldK", maxrss);
+    }
+    fclose(in);
+}
+
+static int compareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/***
+ * readLatencies:
+ *    The 50th and 99th percentile statement times (microseconds), from the
+ *    trace: each statement's parse event and its run event added together.
+ ***/
+static void readLatencies(const char* trace, double* p50, double* p99)
+{
+    *p50 = *p99 = 0;
+    FILE* in = fopen(trace, "r");
+    if (in == NULL) return;
+
+    size_t count = 0;
+    size_t size = 1024;
+    double* times = malloc(size * sizeof(double));
+    double parse = 0;
+    char* line = NULL;
+    size_t length = 0;
+    while (getline(&line, &length, in) != -1)
+    {
+        char* dur = strstr(line, "\"dur\":");
+        if (dur == NULL) continue;
+        double micros = atof(dur + 6);
+        if (strncmp(line, "{\"name\":\"parse\"", 15) == 0)
+        {
+            parse = micros;
+        }
+        else if (strncmp(line, "{\"name\":\"run\"", 13) == 0)
+        {
+            if (count == size) times = realloc(times, (size *= 2) * sizeof(double));
+            times[count++] = parse + micros;
+            parse = 0;
+        }
+    }
+    free(line);
+    fclose(in);
+
+    if (count > 0)
+    {
+        qsort(times, count, sizeof(double), compareDoubles);
+        *p50 = times[count / 2];
+        *p99 = times[count * 99 / 100 < count ? count * 99 / 100 : count - 1];
+    }
+    free(times);
+}
+
+/***
+ * runBench:
+ *    Runs the script both ways, checks its output and prints its line.
+ *    Returns whether the output was right.
+ ***/
+static int runBench(const char* shell, const char* dir, const char* name, const char* script,
+                    const char* golden, long lines)
+{
+    char out[PATH_MAX];
+    char err[PATH_MAX];
+    char trace[PATH_MAX];
+    snprintf(out, sizeof(out), "%s/%s.out", dir, name);
+    snprintf(err, sizeof(err), "%s/%s.err", dir, name);
+    snprintf(trace, sizeof(trace), "%s/%s.trace", dir, name);
+
+    double seconds = runShell(shell, dir, script, out, err, "TECHSHELL_STATS", "1");
+    int ok = sameFiles(out, golden);
+    unsigned long launched;
+    long maxrss;
+    readStats(err, &launched, &maxrss);
+
+    double p50, p99;
+    runShell(shell, dir, script, out, err, "TECHSHELL_TRACE", trace);
+    readLatencies(trace, &p50, &p99);
+
+    printf("bench=%s lines=%ld seconds=%.3f lines/s=%.0f forks/s=%.0f maxrss=%ldK p50=%.1fus p99=%.1fus output=%s\n",
+           name, lines, seconds, lines / seconds, launched / seconds, maxrss, p50, p99,
+           ok ? "ok" : "DIFFERENT");
+    fflush(stdout);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int scale = argc > 1 ? atoi(argv[1]) : 1;
+    char shell[PATH_MAX];
+    char top[PATH_MAX];
+    if (realpath(argc > 2 ? argv[2] : "./techShell", shell) == NULL || getcwd(top, sizeof(top)) == NULL)
+    {
+        perror("techShell");
+        return 1;
+    }
+    if (scale < 1) scale = 1;
+
+    char dir[] = "/tmp/suiteBenchXXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    int ok = 1;
+    char script[PATH_MAX + 32];
+    char golden[PATH_MAX + 32];
+
+    // The scripts from Input/ (their golden output is in Output/)
+    const int given[] = { 2, 3, 5 };
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "shell.%d", given[i]);
+        snprintf(script, sizeof(script), "%s/Input/shell.%d", top, given[i]);
+        snprintf(golden, sizeof(golden), "%s/Output/shell%d.out", top, given[i]);
+        ok &= runBench(shell, dir, name, script, golden, countLines(script));
+    }
+
+    // redirect.in prints nothing, but writes files (in the scratch directory)
+    char copy[PATH_MAX + 32];
+    snprintf(script, sizeof(script), "%s/Input/redirect.in", top);
+    snprintf(copy, sizeof(copy), "%s/redirect.in", dir);
+    snprintf(golden, sizeof(golden), "%s/nothing", dir);
+    copyScript(script, copy);
+    fclose(fopen(golden, "w"));
+    ok &= runBench(shell, dir, "redirect.in", copy, golden, countLines(copy));
+    const char* written[] = { "fileA", "f00", "fooTest", NULL };
+    for (i = 0; written[i] != NULL; i++)
+    {
+        snprintf(script, sizeof(script), "%s/%s", dir, written[i]);
+        snprintf(golden, sizeof(golden), "%s/Output/%s", top, written[i]);
+        if (!sameFiles(script, golden))
+        {
+            printf("bench=redirect.in file=%s output=DIFFERENT\n", written[i]);
+            ok = 0;
+        }
+    }
+
+    snprintf(script, sizeof(script), "%s/Input/catTest.in", top);
+    snprintf(copy, sizeof(copy), "%s/catTest.in", dir);
+    snprintf(golden, sizeof(golden), "%s/Output/catTest.out", top);
+    copyScript(script, copy);
+    ok &= runBench(shell, dir, "catTest.in", copy, golden, countLines(copy));
+
+    snprintf(script, sizeof(script), "%s/Input/background.in", top);
+    snprintf(golden, sizeof(golden), "%s/Output/background.out", top);
+    ok &= runBench(shell, dir, "background.in", script, golden, countLines(script));
+
+    // The generated ones
+    const char* names[] = { "vars", "nesting", "pipeline", "redirect", "hugeline", "parallel", NULL };
+    long (*writers[])(FILE*, FILE*, int) = { writeVars, writeNesting, writePipeline, writeRedirect, writeHugeline,
+                                             writeParallel };
+    for (i = 0; names[i] != NULL; i++)
+    {
+        snprintf(script, sizeof(script), "%s/%s.sh", dir, names[i]);
+        snprintf(golden, sizeof(golden), "%s/%s.golden", dir, names[i]);
+        FILE* scriptFile = fopen(script, "w");
+        FILE* goldenFile = fopen(golden, "w");
+        if (scriptFile == NULL || goldenFile == NULL)
+        {
+            perror(dir);
+            return 1;
+        }
+        long lines = writers[i](scriptFile, goldenFile, scale);
+        fclose(scriptFile);
+        fclose(goldenFile);
+        ok &= runBench(shell, dir, names[i], script, golden, lines);
+    }
+
+    char command[PATH_MAX + 16];
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    if (system(command) != 0) fprintf(stderr, "Could not remove %s\n", dir);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/*******
+ * Dillon Welch
+ *
+ * Tokenizer benchmark:
+ *    Builds one multi-megabyte line of generated words, operators and long
+ *    quoted arguments, then tokenizes it with each delimiter scan
+ *    (see tokenizerUseSimd) and reports the throughput in MB/s.
+ *    The tokens found must be identical for every scan.
+ *
+ *    Usage: tokenizerBench [megabytes] [repeats]
+ *******/
+
+#include "../tokenizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***
+ * makeLine:
+ *    A line of about size bytes.  REFERENCE returned is GIVEN
+ ***/
+static char* makeLine(size_t size)
+{
+    static const char* ops[] = { "|", ";", "<", ">", ">&" };
+    char* line = malloc(size + 4096);
+    size_t len = 0;
+    int i;
+
+    srand(42);
+    while (len < size)
+    {
+        int kind = rand() % 10;
+        if (kind < 5)
+        {
+            // A regular word
+            int n = 1 + rand() % 24;
+            for (i = 0; i < n; i++) line[len++] = 'a' + rand() % 26;
+        }
+        else if (kind < 8)
+        {
+            // A long quoted argument
+            char quote = (kind == 5) ? '\'' : '"';
+            int n = 64 + rand() % 2000;
+            line[len++] = quote;
+            for (i = 0; i < n; i++) line[len++] = (rand() % 8 == 0) ? ' ' : 'A' + rand() % 26;
+            line[len++] = quote;
+        }
+        else
+        {
+            const char* op = ops[rand() % 5];
+            memcpy(line + len, op, strlen(op));
+            len += strlen(op);
+        }
+        line[len++] = (rand() % 4 == 0) ? '\t' : ' ';
+    }
+    line[len++] = '\n';
+    line[len] = '\0';
+    return line;
+}
+
+/***
+ * tokenize:
+ *    Runs the tokenizer over the line, returns a checksum of the tokens.
+ ***/
+static unsigned long tokenize(char* line, long* count)
+{
+    unsigned long sum = 0;
+    aToken tok;
+    *count = 0;
+    startToken(line);
+    for (tok = getNextToken(); tok.type != EOL && tok.type != ERROR; tok = getNextToken())
+    {
+        sum = sum * 31 + tok.type;
+        if (tok.start != NULL) sum = sum * 31 + strlen(tok.start);
+        (*count)++;
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    double megabytes = argc > 1 ? atof(argv[1]) : 8;
+    int repeats = argc > 2 ? atoi(argv[2]) : 5;
+    char* line = makeLine((size_t) (megabytes * 1024 * 1024));
+    size_t bytes = strlen(line);
+    unsigned long expected = 0;
+    int simd;
+
+    printf("%-8s %10s %10s\n", "scan", "tokens", "MB/s");
+    for (simd = 0; simd <= 1; simd++)
+    {
+        const char* name = tokenizerUseSimd(simd);
+        long count;
+        unsigned long sum = tokenize(line, &count);   // Warm up (and check)
+        if (simd == 0) expected = sum;
+        else if (sum != expected)
+        {
+            fprintf(stderr, "%s: tokens differ from scalar scan!\n", name);
+            return 1;
+        }
+
+        double best = 0;
+        int r;
+        for (r = 0; r < repeats; r++)
+        {
+            double start = now();
+            tokenize(line, &count);
+            double rate = bytes / (now() - start) / (1024 * 1024);
+            if (rate > best) best = rate;
+        }
+        printf("%-8s %10ld %10.1f\n", name, count, best);
+    }
+
+    free(line);
+    return 0;
+}
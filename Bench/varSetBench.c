@@ -0,0 +1,71 @@
+/*******
+ * Dillon Welch
+ *
+ * VarSet benchmark:
+ *    Fills a VarSet with N variables (N = 10, 100, ..., 1000000) and
+ *    times findInSet on a random mix of hits and misses.
+ *    The cost per lookup should stay flat as N grows.
+ *
+ *    Usage: varSetBench [lookups]
+ *******/
+
+#include "../varSet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_VARS 1000000
+#define NAME_LENGTH 32
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    long lookups = argc > 1 ? atol(argv[1]) : 2000000;
+    char name[NAME_LENGTH];
+    int n;
+
+    printf("%10s %12s %12s\n", "vars", "ns/lookup", "ns/add");
+    for (n = 10; n <= MAX_VARS; n *= 10)
+    {
+        VarSet* set = createVarSet();
+        int i;
+
+        double start = now();
+        for (i = 0; i < n; i++)
+        {
+            snprintf(name, NAME_LENGTH, "var%d", i);
+            addToSet(set, name, "value", 0);
+        }
+        double addTime = now() - start;
+
+        // Half of the names looked up exist, half do not.
+        srand(n);
+        long found = 0, l;
+        start = now();
+        for (l = 0; l < lookups; l++)
+        {
+            snprintf(name, NAME_LENGTH, "var%d", rand() % (2 * n));
+            if (findInSet(set, name) != NULL) found++;
+        }
+        double findTime = now() - start;
+
+        // Subtract the cost of building the names themselves.
+        start = now();
+        for (l = 0; l < lookups; l++)
+        {
+            snprintf(name, NAME_LENGTH, "var%d", rand() % (2 * n));
+        }
+        findTime -= now() - start;
+
+        printf("%10d %12.1f %12.1f   (%ld hits)\n", n, findTime * 1e9 / lookups,
+               addTime * 1e9 / n, found);
+        freeVarSet(set);
+    }
+    return 0;
+}
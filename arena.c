@@ -0,0 +1,148 @@
+/*******
+ * Dillon Welch
+ *
+ * Arena:
+ *    See arena.h for details.
+ *******/
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_SIZE (64 * 1024)
+#define ALIGNMENT 16
+
+/***
+ * initArena:
+ *    Start with an empty arena (no chunks until the first allocation).
+ ***/
+void initArena(Arena* arena)
+{
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->last = NULL;
+    arena->mallocs = 0;
+    arena->allocs = 0;
+    arena->bytes = 0;
+    arena->resets = 0;
+}
+
+/***
+ * freeArena:
+ *    Frees every chunk (everything allocated from the arena).
+ ***/
+void freeArena(Arena* arena)
+{
+    ArenaChunk* chunk = arena->head;
+    while (chunk != NULL)
+    {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->last = NULL;
+}
+
+/***
+ * resetArena:
+ *    Everything allocated is given back (but the chunks are kept).
+ ***/
+void resetArena(Arena* arena)
+{
+    if (arena->head != NULL) arena->head->used = 0;
+    arena->current = arena->head;
+    arena->last = NULL;
+    arena->resets++;
+}
+
+/***
+ * arenaAlloc:
+ *    Returns size bytes (aligned for any type).
+ *    REFERENCE returned is BORROWED (valid until the arena is reset)
+ ***/
+void* arenaAlloc(Arena* arena, size_t size)
+{
+    size = (size + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+
+    // Move on to the next (kept) chunk while this one is too full
+    ArenaChunk* chunk = arena->current;
+    while (chunk != NULL && chunk->size - chunk->used < size && chunk->next != NULL)
+    {
+        chunk = chunk->next;
+        chunk->used = 0;
+    }
+
+    if (chunk == NULL || chunk->size - chunk->used < size)
+    {
+        // Need a new chunk (big enough for this allocation)
+        size_t chunkSize = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+        ArenaChunk* fresh = malloc(sizeof(ArenaChunk) + chunkSize);
+        if (fresh == NULL) return NULL;
+        fresh->size = chunkSize;
+        fresh->used = 0;
+        arena->mallocs++;
+
+        if (chunk == NULL)
+        {
+            fresh->next = arena->head;
+            arena->head = fresh;
+        }
+        else
+        {
+            fresh->next = chunk->next;
+            chunk->next = fresh;
+        }
+        chunk = fresh;
+    }
+
+    arena->current = chunk;
+    void* ans = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->last = ans;
+    arena->allocs++;
+    arena->bytes += size;
+    return ans;
+}
+
+/***
+ * arenaRealloc:
+ *    Grows ptr (oldSize bytes) to newSize bytes.  The most recent allocation
+ *    is grown in place when its chunk has room, otherwise it is copied.
+ *    REFERENCE returned is BORROWED (valid until the arena is reset)
+ ***/
+void* arenaRealloc(Arena* arena, void* ptr, size_t oldSize, size_t newSize)
+{
+    if (ptr == NULL) return arenaAlloc(arena, newSize);
+
+    oldSize = (oldSize + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+    newSize = (newSize + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+    if (newSize <= oldSize) return ptr;
+
+    ArenaChunk* chunk = arena->current;
+    if (ptr == arena->last && chunk->size - chunk->used >= newSize - oldSize)
+    {
+        // Just bump the end
+        chunk->used += newSize - oldSize;
+        arena->bytes += newSize - oldSize;
+        return ptr;
+    }
+
+    void* ans = arenaAlloc(arena, newSize);
+    if (ans != NULL) memcpy(ans, ptr, oldSize);
+    return ans;
+}
+
+/***
+ * arenaStrndup:
+ *    Copy of the first n characters of s (null-terminated) in the arena.
+ ***/
+char* arenaStrndup(Arena* arena, const char* s, size_t n)
+{
+    char* ans = arenaAlloc(arena, n + 1);
+    if (ans == NULL) return NULL;
+    memcpy(ans, s, n);
+    ans[n] = '\0';
+    return ans;
+}
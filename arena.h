@@ -0,0 +1,49 @@
+/*******
+ * Dillon Welch
+ *
+ * Arena:
+ *    A bump allocator for memory that only lives as long as one statement
+ *    (the Command and ArgList nodes, expanded tokens, redirect file names
+ *    and the argument array for exec).
+ *
+ *    Memory is handed out from large chunks.  Nothing is freed on its own:
+ *    resetArena makes all of it available again at once (at the end of
+ *    each statement).  Chunks are kept across resets, so once the arena
+ *    has grown to fit the largest statement no more mallocs are needed.
+ *******/
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stddef.h>
+
+typedef struct arenaChunk
+{
+    struct arenaChunk* next;  // The next chunk (REFERENCE is OWNED)
+    size_t size;              // Bytes in data
+    size_t used;              // Bytes of data handed out
+    char data[];
+} ArenaChunk;
+
+typedef struct
+{
+    ArenaChunk* head;     // First chunk (REFERENCE is OWNED)
+    ArenaChunk* current;  // Chunk being allocated from (REFERENCE is BORROWED - in head's list)
+    void* last;           // The most recent allocation (can be grown in place)
+
+    // Allocation counters
+    unsigned long mallocs;   // Chunks malloc'd (ever)
+    unsigned long allocs;    // Allocations handed out (ever)
+    unsigned long bytes;     // Bytes handed out (ever)
+    unsigned long resets;    // Times the arena was reset
+} Arena;
+
+void initArena(Arena* arena);
+void freeArena(Arena* arena);
+void resetArena(Arena* arena);
+
+void* arenaAlloc(Arena* arena, size_t size);   // REFERENCE returned is BORROWED (until reset)
+void* arenaRealloc(Arena* arena, void* ptr, size_t oldSize, size_t newSize);
+char* arenaStrndup(Arena* arena, const char* s, size_t n);
+
+#endif
@@ -14,12 +14,18 @@
 #include "global.h"
 #include "varSet.h"
 #include "command.h"
+#include "pathCache.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "trace.h"
+#include "stats.h"
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 
 void processSet(Command* cmd);
 void processList(Command* cmd);
@@ -27,9 +33,35 @@ void processExit(Command* cmd);
 void processStatus(Command* cmd);
 void processCD(Command* cmd);
 void processPWD(Command* cmd);
+void processHash(Command* cmd);
+void processJobs(Command* cmd);
+void processWait(Command* cmd);
+void processStats(Command* cmd);
 
-char *builtinNames[] = { "SET", "LIST", "EXIT", "STATUS", "CD", "PWD", NULL };
-void (*builtinFn[])(Command*) = { processSet, processList, processExit, processStatus, processCD, processPWD, NULL };
+char *builtinNames[] = { "SET", "LIST", "EXIT", "STATUS", "CD", "PWD", "HASH", "JOBS", "WAIT", "PARALLEL", "STATS", NULL };
+void (*builtinFn[])(Command*) = { processSet, processList, processExit, processStatus, processCD, processPWD, processHash, processJobs, processWait, processParallel, processStats, NULL };
+
+/***
+ * The current directory, kept from one CD to the next (so it is not looked
+ * up after every command), and HOME (read once, at start up).
+ ***/
+static char* cwd = NULL;         // The current directory (REFERENCE is OWNED)
+static const char* home = NULL;  // HOME (NULL if not set) (REFERENCE is BORROWED - the environment)
+static size_t homeLength = 0;
+
+/***
+ * isBuiltin:
+ *    Whether name is the name of a builtin.
+ ***/
+int isBuiltin(const char* name)
+{
+    int i;
+    for (i = 0; builtinNames[i] != NULL; i++)
+    {
+        if (strcasecmp(name, builtinNames[i]) == 0) return 1;
+    }
+    return 0;
+}
 
 /***
  * processBuiltin:
@@ -48,39 +80,66 @@ int processBuiltin(Command* cmd)
     {
         if (strcasecmp(cmd->command, builtinNames[i]) == 0) // Does the given command match the builtin string name
         {
-            int savedIn;  // Saved input stream.
-            int savedOut; // Saved output stream.
+            int savedIn = -1;  // Saved input stream.
+            int savedOut = -1; // Saved output stream.
+            int savedErr = -1; // Saved error stream.
             if (cmd->input == PIPE_IN) // If input is from a pipe, dup the input stream.
             {
-                savedIn = dup(0);
+                savedIn = fcntl(0, F_DUPFD_CLOEXEC, 3);
                 dup2(comm[0], 0);
                 close(comm[0]);
             }
             if (cmd->output == PIPE_OUT) // If output is from a pipe, dup the output stream.
             {
-                savedOut = dup(1);
-                if (pipe(comm) == -1)
-                {
-                    fprintf(stderr, "Error occurred opening pipe: %s\n", strerror(errno));
-                    exit(1);
-                }
+                savedOut = fcntl(1, F_DUPFD_CLOEXEC, 3);
+                makePipe();
                 dup2(comm[1], 1);
                 close(comm[1]);
             }
 
+            // Files (opened already - see openRedirects) win over pipes.
+            fflush(stdout);
+            fflush(stderr);
+            if (cmd->inFd != -1)
+            {
+                if (savedIn == -1) savedIn = fcntl(0, F_DUPFD_CLOEXEC, 3);
+                dup2(cmd->inFd, 0);
+            }
+            if (cmd->outFd != -1)
+            {
+                if (savedOut == -1) savedOut = fcntl(1, F_DUPFD_CLOEXEC, 3);
+                dup2(cmd->outFd, 1);
+            }
+            if (cmd->errFd != -1)
+            {
+                savedErr = fcntl(2, F_DUPFD_CLOEXEC, 3);
+                dup2(cmd->errFd, 2);
+            }
+
+            double start = traceClock();
+            stats.builtins++;
+            builtinStatus = 0;
             (builtinFn[i])(cmd); // Execute the builtin.
+            traceEvent("builtin", start, cmd->command, 0);
+            fflush(stdout);   // (What it printed goes where it was redirected)
+            fflush(stderr);
 
-            // Restore standard in and out if necessary
-            if (cmd->input == PIPE_IN)
+            // Restore standard in, out and error if necessary
+            if (savedIn != -1)
             {
                 dup2(savedIn, 0);
                 close(savedIn);
             }
-            if (cmd->output == PIPE_OUT)
+            if (savedOut != -1)
             {
                 dup2(savedOut, 1);
                 close(savedOut);
             }
+            if (savedErr != -1)
+            {
+                dup2(savedErr, 2);
+                close(savedErr);
+            }
             return 1;    // And return  1 (found builtin)
         }
     }
@@ -151,9 +210,8 @@ void processCD(Command* cmd)
 {
     int error; // For storing the return value of chdir, will be -1 if there was an error.
 
-    if(cmd->head == NULL) // If no arg given, chdir to HOME.
+    if(cmd->head == NULL) // If no arg given, chdir to HOME (as it was at start up).
     {
-        char *home = getenv("HOME");
         if(home == NULL) // If there is no home, chdir to root.
         {
             error = chdir("/");
@@ -176,93 +234,135 @@ void processCD(Command* cmd)
             fprintf(stderr, "Directory %s not found.\n", cmd->head->arg);
         }
     }
-    findDir();
-}
-
-/***
- * stringCopy:
- *    Customized copy function, pass it the length of HOME and it will copy src into dest from the correct point.
- ***/
-char *stringCopy(char *dest, const char *src, size_t n, size_t homeLength)
-{
-    size_t i;
-    // i = 2 because of ~/, i - 1 + homeLength starts at the first character after HOME/.
-    for (i = 2 ; i < n && src[i - 1 + homeLength] != '\0' ; i++)
-        dest[i] = src[i - 1 + homeLength];
-    for ( ; i < n ; i++)
-        dest[i] = '\0';
-
-    return dest;
 
+    if(error == 0)
+    {
+        findDir();   // The directory changed
+    }
 }
 
 /***
- * findDir:
- *     Finds the current directory and sets dir to it (for printing the current directory in the prompt).
+ * processHash:
+ *    The command path cache (see pathCache.h).
+ *    With no args, lists the cached commands.
+ *    HASH -r empties the cache.
+ *    Otherwise each arg is a command to look up (and cache) now.
  ***/
-void findDir()
+void processHash(Command* cmd)
 {
-    char tilde[2] = "~/"; // Replaces HOME part of current working directory.
-    char *home = getenv("HOME");   // Gets the home directory (HOME) ands its length.
-    int homeLength = strlen(home); // Length of HOME.
-    char *holder = malloc(1000 * sizeof(char)); // Variable for the current working directory.
-    getcwd(holder, 1000); 	// Gets the current working directory and stores it in holder.
+    if (cmd->head == NULL)
+    {
+        printPathCache(stdout);
+        fflush(stdout);
+        return;
+    }
 
-    if(strncmp(holder, home, homeLength) == 0) // If the current working directory starts out with the home directory.
+    ArgList* curr;
+    for (curr = cmd->head; curr != NULL; curr = curr->next)
     {
-        if(*(holder + homeLength) == '\0') // If the current working directory is just the home directory, print '~'.
+        if (strcmp(curr->arg, "-r") == 0)
         {
-            dir = t;
+            clearPathCache();
         }
-        else // Otherwise make a new string, copy ~/ into it, and then copy the part of the cwd that isn't the home directory.
+        else if (commandPath(curr->arg) == NULL)
         {
-            char *pwd = malloc(1000 * sizeof(char));
-            strncpy(pwd, tilde, 2);
-            stringCopy(pwd, holder, 1000, homeLength);
-            dir = pwd;
-            free(pwd);
+            fprintf(stderr, "HASH: %s not found\n", curr->arg);
         }
     }
-    else // Otherwise print out holder, as cwd does not have the home directory in it (for example "/").
+}
+
+/***
+ * processStats:
+ *    Prints the shell's counters (see stats.h).
+ *    STATS -r starts them over instead.
+ ***/
+void processStats(Command* cmd)
+{
+    if (cmd->head != NULL && strcmp(cmd->head->arg, "-r") == 0)
     {
-        dir = holder;
+        clearStats(&statementArena);
+        return;
     }
-    free(holder);
+    printStats(stdout, &statementArena);
+    fflush(stdout);
 }
 
 /***
- * processPWD:
- *    Prints the working directory, with the home directory truncated.
+ * processJobs:
+ *    Lists the background jobs (see jobs.h).
  ***/
-void processPWD(Command *cmd)
+void processJobs(Command* cmd)
+{
+    printJobs(stdout);
+    fflush(stdout);
+}
+
+/***
+ * processWait:
+ *    Waits for the given background jobs (as 2 or %2) to finish,
+ *    or for all of them with no args.
+ ***/
+void processWait(Command* cmd)
 {
-    char tilde[2] = "~/"; // Replaces HOME part of current working directory.
-    char *home = getenv("HOME");   // Gets the home directory ands its length.
-    int homeLength = strlen(home); // Length of HOME.
-    char *holder = malloc(1000 * sizeof(char)); // Variable for the current working directory.
-    getcwd(holder, 1000); 	// Gets the current working directory and stores it in holder.
+    if (cmd->head == NULL)
+    {
+        waitJobs();
+        return;
+    }
 
-    if(strncmp(holder, home, homeLength) == 0) // If the current working directory starts out with the home directory..
+    ArgList* curr;
+    for (curr = cmd->head; curr != NULL; curr = curr->next)
     {
-        if(*(holder + homeLength) == '\0') // If the current working directory is just the home directory, print '~'.
-        {
-            //printf("~\n");
-            printf("%s\n", home);
-        }
-        else   // Otherwise make a new string, copy ~/ into it, and then copy the part of the cwd that isn't the home directory.
+        char* id = curr->arg + (curr->arg[0] == '%');
+        if (!waitJob(atoi(id)))
         {
-            char *pwd = malloc(1000 * sizeof(char));
-            strncpy(pwd, tilde, 2);
-            stringCopy(pwd, holder, 1000, homeLength);
-            printf("%s\n", pwd);
-            dir = pwd;
-            free(pwd);
+            fprintf(stderr, "WAIT: %s: No such job\n", curr->arg);
         }
     }
-    else // Otherwise print out holder, as cwd does not have the home directory in it.
+}
+
+/***
+ * findDir:
+ *     Finds the current directory and sets dir to it (for printing the current directory in the prompt),
+ *     with the home directory shown as ~ (~/rest for a directory under it).
+ *     Only needs to be done at start up and when CD changes directory.
+ ***/
+void findDir()
+{
+    if (cwd == NULL)
+    {
+        // First time - HOME is not looked at again
+        home = getenv("HOME");
+        homeLength = home == NULL ? 0 : strlen(home);
+    }
+
+    free(cwd);
+    free(dir);
+    cwd = getcwd(NULL, 0);
+    if (cwd == NULL)
     {
-        printf("%s\n", holder);
-        dir = holder;
+        cwd = strdup("?");   // (It was removed, say)
     }
-    free(holder);
+
+    if (home != NULL && homeLength > 0 && strncmp(cwd, home, homeLength) == 0 &&
+        (cwd[homeLength] == '\0' || cwd[homeLength] == '/'))
+    {
+        // In the home directory: ~, or ~/ and the rest of the path
+        dir = malloc(strlen(cwd + homeLength) + 2);
+        sprintf(dir, "~%s", cwd + homeLength);
+    }
+    else
+    {
+        dir = strdup(cwd);
+    }
+}
+
+/***
+ * processPWD:
+ *    Prints the working directory, with the home directory truncated
+ *    (as in the prompt - but the home directory itself is printed in full).
+ ***/
+void processPWD(Command *cmd)
+{
+    printf("%s\n", strcmp(dir, "~") == 0 ? cwd : dir);
 }
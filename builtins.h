@@ -14,6 +14,13 @@
  *       STATUS
  *       CD
  *       PWD
+ *       HASH
+ *       JOBS
+ *       WAIT
+ *       PARALLEL (see parallel.h)
+ *       STATS (see stats.h)
+ *    (TIME is not one of these: it is taken off the front of the statement
+ *    when it is parsed - see timing.h.)
  *******/
 
 #ifndef __BUILTINS_H
@@ -23,6 +30,6 @@
 #include <stdio.h>
 
 int processBuiltin(Command* cmd);
-char *stringCopy(char *dest, const char *src, size_t n, size_t homeLength);
+int isBuiltin(const char* name);
 void findDir();
 #endif
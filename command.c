@@ -7,78 +7,334 @@
  *    See command.h for details.
  *******/
 
+#define _GNU_SOURCE
 #include "command.h"
 #include "global.h"
+#include "arena.h"
 #include "builtins.h"
+#include "pathCache.h"
+#include "jobs.h"
+#include "fastPath.h"
+#include "parallel.h"
+#include "timing.h"
+#include "trace.h"
+#include "stats.h"
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <spawn.h>
+
+extern char** environ;
 
 /***
  * newCommand:
- *   Create a new command using given string
+ *   Create a new command (in the statement arena) using given string
  *   Creates a null list of arguments
- *   REFERENCE returned is GIVEN
+ *   cmd: REFERENCE is BORROWED (must last the whole statement)
+ *   REFERENCE returned is BORROWED (until the statement arena is reset)
  ***/
-Command* newCommand(const char* cmd)
+Command* newCommand(char* cmd)
 {
-    Command* ans = malloc(sizeof(Command));
-    ans->command = strdup(cmd);
+    Command* ans = arenaAlloc(&statementArena, sizeof(Command));
+    ans->command = cmd;
     ans->head = NULL;
     ans->tail = NULL;
     ans->input = STDIN; // By default
     ans->output = STDOUT; // By default
+    ans->inFile = NULL;   // No redirects
+    ans->outFile = NULL;
+    ans->errFile = NULL;
+    ans->append = 0;
+    ans->inFd = -1;
+    ans->outFd = -1;
+    ans->errFd = -1;
+    ans->reader = NULL;
     return ans;
 }
 
 /***
- * freeCommand:
- *   Frees up the given command - and its argument list
- *   REFERENCE given is STOLEN (and freed)
+ * useFork:
+ *    Whether commands are to be launched with fork (SET SPAWN fork)
+ *    rather than posix_spawn.
  ***/
-void freeCommand(Command* cmd)
+static int useFork()
 {
-    free(cmd->command);
+    VarEntry* mode = findInSet(varList, "SPAWN");
+    return mode != NULL && strcasecmp(mode->value, "fork") == 0;
+}
 
-    ArgList* head = cmd->head;
-    while (head != NULL)
+/***
+ * launchError:
+ *    Reports that the command could not be started (same message as from
+ *    a forked child, and to the same place - its >& file, if it has one).
+ *    (A missing input file is reported by openRedirects.)
+ ***/
+static void launchError(Command* cmd)
+{
+    if (cmd->errFd != -1) dprintf(cmd->errFd, "Error: Command not recognized\n");
+    else fprintf(stderr, "Error: Command not recognized\n");
+}
+
+/***
+ * scriptArgs:
+ *    The arguments to run path (an executable file that is not a program -
+ *    a script without a #! line) with /bin/sh, as execvp does:
+ *       sh path args...
+ *    REFERENCE returned is BORROWED (from the statement arena)
+ ***/
+static char** scriptArgs(const char* path, char** args)
+{
+    int count;
+    for (count = 0; args[count] != NULL; count++);
+    char** shArgs = arenaAlloc(&statementArena, (count + 2) * sizeof(char*));
+    shArgs[0] = "sh";
+    shArgs[1] = (char*) path;
+    int i;
+    for (i = 1; i <= count; i++) shArgs[i + 1] = args[i];   // (Including the NULL)
+    return shArgs;
+}
+
+/***
+ * openRedirect:
+ *    Opens one redirect file, close-on-exec: only the command it is for
+ *    gets it (dup'd onto its 0, 1 or 2).  Files are created (if need be)
+ *    with the same permissions as always.
+ *    Returns the descriptor, or -1 (after reporting why).
+ ***/
+static int openRedirect(const char* name, int flags)
+{
+    int file;
+    while ((file = open(name, flags | O_CLOEXEC, S_IRWXU)) == -1 && errno == EINTR);
+    if (file == -1)
     {
-        ArgList* next = head->next; // Just in case ref. is lost
-        free(head->arg);
-        free(head);
-        head = next;
+        if (flags == O_RDONLY && errno == ENOENT) fprintf(stderr, "%s: File does not exist\n", name);
+        else fprintf(stderr, "%s: %s\n", name, strerror(errno));
     }
+    return file;
+}
 
-    free(cmd);
+/***
+ * openRedirects:
+ *    Opens the command's redirect files (the ones not open yet): '<' to
+ *    read, '>' and '>&' emptied first, '>>' to append to.  They are opened
+ *    here in the shell, once, so a file that can not be opened is reported
+ *    before anything is started (and then none of the statement is run -
+ *    see processStatement).
+ *    Returns 0 if one could not be opened.
+ ***/
+int openRedirects(Command* cmd)
+{
+    if (cmd->inFile != NULL && cmd->inFd == -1)
+    {
+        if ((cmd->inFd = openRedirect(cmd->inFile, O_RDONLY)) == -1) return 0;
+    }
+    if (cmd->outFile != NULL && cmd->outFd == -1)
+    {
+        int mode = cmd->append ? O_APPEND : O_TRUNC;
+        if ((cmd->outFd = openRedirect(cmd->outFile, O_WRONLY | O_CREAT | mode)) == -1) return 0;
+    }
+    if (cmd->errFile != NULL && cmd->errFd == -1)
+    {
+        if ((cmd->errFd = openRedirect(cmd->errFile, O_WRONLY | O_CREAT | O_TRUNC)) == -1) return 0;
+    }
+    return 1;
+}
+
+/***
+ * closeRedirects:
+ *    Closes the command's redirect files (once it is started).
+ ***/
+static void closeRedirects(Command* cmd)
+{
+    if (cmd->inFd != -1) close(cmd->inFd);
+    if (cmd->outFd != -1) close(cmd->outFd);
+    if (cmd->errFd != -1) close(cmd->errFd);
+    cmd->inFd = cmd->outFd = cmd->errFd = -1;
+}
+
+/***
+ * forkCommand:
+ *    Launch the command (found at path) with fork: the child sets up its
+ *    pipes and redirects itself, then execs.
+ *    Returns the process id of the child.
+ ***/
+static int forkCommand(Command* cmd, const char* path, char** args, int inputPipe)
+{
+    stats.forks++;
+    int child = fork();
+    if (child == 0)
+    {
+        // Child process
+        if (cmd->input == PIPE_IN) // If input is from a pipe, redirect input from previous pipe.
+        {
+            dup2(inputPipe, 0); // Make Inputstream (of this proc.) be pipe in.
+            close(inputPipe); // inputPipe is now 0.
+        }
+
+        if (cmd->output == PIPE_OUT) // If output is to a pipe, redirect output to a new pipe.
+        {
+            dup2(comm[1], 1); // Make Outstream of this process be pipe out.
+            close(comm[1]); // Comm[1] is now 1.
+            close(comm[0]); // Important: close streams you don't need.
+        }
+
+        // Files (opened already - see openRedirects) win over pipes.
+        if (cmd->inFd != -1) dup2(cmd->inFd, 0);
+        if (cmd->outFd != -1) dup2(cmd->outFd, 1);
+        if (cmd->errFd != -1) dup2(cmd->errFd, 2);
+
+        traceExec(path);
+        execve(path, args, environ); // Execute the command
+        if (errno == ENOEXEC)
+        {
+            // Not a program - a script without #!, for the shell
+            execve("/bin/sh", scriptArgs(path, args), environ);
+        }
+        fprintf(stderr, "Error: Command not recognized\n"); // It failed, print an error and exit.
+        exit(1);
+    }
+    return child;
+}
+
+/***
+ * spawnCommand:
+ *    Launch the command (found at path) with posix_spawn (which does not
+ *    copy the shell's memory the way fork does).  The pipes and redirects
+ *    are given as file actions, done in the same order as forkCommand does them.
+ *    Returns the process id of the child, or -1 if it could not be started
+ *    (after reporting why).
+ ***/
+static int spawnCommand(Command* cmd, const char* path, char** args, int inputPipe)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    if (cmd->input == PIPE_IN) // If input is from a pipe, redirect input from previous pipe.
+    {
+        posix_spawn_file_actions_adddup2(&actions, inputPipe, 0);
+        posix_spawn_file_actions_addclose(&actions, inputPipe);
+    }
+
+    if (cmd->output == PIPE_OUT) // If output is to a pipe, redirect output to the new pipe.
+    {
+        posix_spawn_file_actions_adddup2(&actions, comm[1], 1);
+        posix_spawn_file_actions_addclose(&actions, comm[1]);
+        posix_spawn_file_actions_addclose(&actions, comm[0]);
+    }
+
+    // Files (opened already - see openRedirects) win over pipes.
+    if (cmd->inFd != -1) posix_spawn_file_actions_adddup2(&actions, cmd->inFd, 0);
+    if (cmd->outFd != -1) posix_spawn_file_actions_adddup2(&actions, cmd->outFd, 1);
+    if (cmd->errFd != -1) posix_spawn_file_actions_adddup2(&actions, cmd->errFd, 2);
+
+    stats.spawns++;
+    pid_t child;
+    int error = posix_spawn(&child, path, &actions, NULL, args, environ);
+    if (error == ENOENT && access(path, F_OK) == -1)
+    {
+        // The cached path is out of date (and PATH was not checked yet) - look again
+        clearPathCache();
+        path = commandPath(cmd->command);
+        if (path != NULL) error = posix_spawn(&child, path, &actions, NULL, args, environ);
+    }
+    if (error == ENOEXEC)
+    {
+        // Not a program - a script without #!, for the shell (as execvp does)
+        error = posix_spawn(&child, "/bin/sh", &actions, NULL, scriptArgs(path, args), environ);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (error != 0)
+    {
+        stats.failures++;
+        launchError(cmd);
+        return -1;
+    }
+    return child;
+}
+
+/***
+ * pipeSize:
+ *    The pipe buffer size asked for with PIPESIZE (bytes, or with a K or M
+ *    after the number), 0 if it is not set (or is not a size).
+ ***/
+static long pipeSize()
+{
+    VarEntry* size = findInSet(varList, "PIPESIZE");
+    if (size == NULL) return 0;
+
+    char* end;
+    long bytes = strtol(size->value, &end, 10);
+    if (*end == 'k' || *end == 'K') bytes *= 1024;
+    else if (*end == 'm' || *end == 'M') bytes *= 1024 * 1024;
+    else if (*end != '\0') return 0;
+    return bytes > 0 ? bytes : 0;
+}
+
+/***
+ * makePipe:
+ *    Creates a new pipe in comm.  Both ends are close-on-exec: a command
+ *    gets the end it uses dup'd onto its 0 or 1, so no command keeps any
+ *    other pipe of the statement open.
+ *    The pipe's buffer is made PIPESIZE big, if that is set (the kernel
+ *    rounds it up to a power of two pages).  If it can not be, the
+ *    pipe keeps the default size (64 KB) and a warning is printed (once
+ *    for each size).
+ *    Exits the shell if no pipe can be made at all.
+ ***/
+void makePipe()
+{
+    if (pipe2(comm, O_CLOEXEC) == -1)
+    {
+        fprintf(stderr, "Error occurred opening pipe: %s\n", strerror(errno));
+        exit(1);
+    }
+    stats.pipes++;
+
+    static long warned = 0;   // The last size that could not be set
+    long size = pipeSize();
+    if (size > 0 && fcntl(comm[1], F_SETPIPE_SZ, (int) (size > INT_MAX ? INT_MAX : size)) == -1 && size != warned)
+    {
+        fprintf(stderr, "Warning: PIPESIZE %ld: %s\n", size, strerror(errno));
+        warned = size;
+    }
 }
 
 /***
  * processCommand:
  *    Process the command.
  *    Execute the commands
- *       Some are via exec
+ *       Some are via exec (found through the path cache, and launched with
+ *       posix_spawn - or fork if SPAWN is fork)
+ *       A few common ones are run in the shell itself (see fastPath.h)
  *       Otherwise process certain builtin commands.
+ *    background: whether the statement is run in the background (the
+ *    shell must not wait on any of it - see fastPath.h)
  *    REFERENCEs are BORROWED
- *    Returns process id of child command (0 if builtin)
+ *    Returns process id of child command (0 if builtin or run in the shell, -1 if it could not be started)
  ***/
-int processCommand(Command* cmd)
+int processCommand(Command* cmd, int background)
 {
     assert(cmd != NULL);
 
     if (!processBuiltin(cmd)) // processBuiltin will execute a builtin
     {
         int a = 0; // Index for args.
-        char **args = (char**) calloc(1000, sizeof(char*)); // Argument array (for execvp).
+        ArgList* curr;
+        for (curr = cmd->head; curr != NULL; curr = curr->next) a++;
+        char **args = arenaAlloc(&statementArena, (a + 2) * sizeof(char*)); // Argument array (for execvp).
 
-        ArgList* curr = cmd->head;
-        *(args + a) = cmd->command;
+        curr = cmd->head;
+        *args = cmd->command;
         for (a = 1; curr != NULL; a++, curr = curr->next) // Populates the array with cmd and its args.
         {
             *(args + a) = curr->arg;
@@ -87,106 +343,58 @@ int processCommand(Command* cmd)
         *(args + a) = NULL; // Null terminated array necessary for execvp.
 
         int inputPipe = comm[0];
-        if (cmd->output == PIPE_OUT || cmd->output == OFILE) // If output is to a pipe or a file
+        if (cmd->output == PIPE_OUT) // If output is to a pipe
         {
             // Create a new pipe
-            if (pipe(comm) == -1)
-            {
-                fprintf(stderr, "Error occurred opening pipe: %s\n", strerror(errno));
-                exit(1);
-            }
+            makePipe();
         }
 
-        int child = fork();
-        if (child == 0)
+        // Find the command on PATH (cached) - so an unknown one is not even started
+        //    (echo, cat, true and false may not need to be - see fastPath.h)
+        const char* path = NULL;
+        int child = 0;
+        double start = traceClock();
+        if (processFastPath(cmd, args, inputPipe, background))
+        {
+            // Done already (its status is in builtinStatus)
+            stats.fastPaths++;
+            traceEvent("fastpath", start, cmd->command, 0);
+        }
+        else if ((path = commandPath(cmd->command)) == NULL)
         {
-            // Child process
-            if (cmd->input == PIPE_IN) // If input is from a pipe, redirect input from previous pipe.
-            {
-                dup2(inputPipe, 0); // Make Inputstream (of this proc.) be pipe in.
-                close(inputPipe); // inputPipe is now 0.
-            }
-
-            if (cmd->output == PIPE_OUT) // If output is to a pipe, redirect output to a new pipe.
-            {
-                dup2(comm[1], 1); // Make Outstream of this process be pipe out.
-                close(comm[1]); // Comm[1] is now 1.
-                close(comm[0]); // Important: close streams you don't need.
-            }
-
-            if (cmd->input == IFILE || inputFlag == 1) // If input is from a file, redirect input from the file.
-            {
-                int file = open(input, O_RDONLY); // If the file exists, open it.
-                if(file == -1) // If the file doesn't exist, print an error and exit.
-                {
-                    fprintf(stderr, "%s: File does not exist\n", input);
-                    exit(1);
-                }
-                dup2(file, 0); // Make the file stream be the input stream.
-                close(file); // file is now 0.
-                free(input);
-            }
-
-            if (cmd->output == OFILE || outputFlag == 1) // If output is to a file, redirect to the file.
-            {
-                int file = open(output, O_WRONLY); // If the file exists, open it.
-                if(file == -1)
-                {
-                    file = creat(output, S_IRWXU); // If it doesn't exist, create it.
-                }
-                dup2(file, 1); // Make outstream of this process to be the file.
-                close(file); // File is now 1.
-                close(comm[0]); // Don't need this anymore.
-                free(output);
-            }
-
-            if (cmd->output == ERRFILE || errorFlag == 1)
-            {
-                int file = open(error, O_WRONLY); // If the file exists, open it.
-                if(file == -1)
-                {
-                    file = creat(error, S_IRWXU); // If it doesn't exist, create it.
-                }
-                dup2(file, 2);  // Make outstream to be error.
-                close(file);    // file is now 2.
-                close(comm[0]); // Don't need this anymore.
-                free(error);
-            }
-
-            if (execvp(cmd->command, args) == -1) // Execute the command, if it fails then print an error and exit.
-            {
-                fprintf(stderr, "Error: Command not recognized\n");
-            }
-            exit(1);
+            stats.failures++;
+            launchError(cmd);
+            child = -1;
         }
         else
         {
-            // Close all unneeded pipes
-            if (cmd->input == PIPE_IN) close(inputPipe);
-            if (cmd->output == PIPE_OUT) close(comm[1]);
+            int forked = useFork();
+            child = forked ? forkCommand(cmd, path, args, inputPipe) : spawnCommand(cmd, path, args, inputPipe);
+            traceEvent(forked ? "fork" : "spawn", start, cmd->command, child);
         }
-        free(args);
-        args = NULL;
-        findDir();
+
+        // Close all unneeded pipes
+        if (cmd->input == PIPE_IN) close(inputPipe);
+        if (cmd->output == PIPE_OUT) close(comm[1]);
+
         return child;
     }
     else
     {
         // Builtins return 0 for child id
-        findDir();
         return 0;
     }
 }
 
 /***
  * addArg:
- *    Add a new argument to the command
- *    REFERENCEs are BORROWED
+ *    Add a new argument to the command (the node is in the statement arena)
+ *    REFERENCEs are BORROWED (arg must last the whole statement)
  ***/
-void addArg(Command* cmd, const char* arg, int token)
+void addArg(Command* cmd, char* arg, int token)
 {
     // Allocate memory (be sure to check for Out-of-mem)
-    ArgList* newArg = malloc(sizeof(ArgList));
+    ArgList* newArg = arenaAlloc(&statementArena, sizeof(ArgList));
 
     if (newArg == NULL)
     {
@@ -195,7 +403,7 @@ void addArg(Command* cmd, const char* arg, int token)
     }
 
     // Store the contents (the new argument)
-    newArg->arg = strdup(arg);
+    newArg->arg = arg;
     newArg->next = NULL;
     newArg->tokenType = token;
 
@@ -210,3 +418,209 @@ void addArg(Command* cmd, const char* arg, int token)
         cmd->tail = cmd->tail->next = newArg;
     }
 }
+
+/***
+ * newStatement:
+ *   Create a new (empty) statement in the statement arena.
+ *   REFERENCE returned is BORROWED (until the statement arena is reset)
+ ***/
+Statement* newStatement()
+{
+    Statement* ans = arenaAlloc(&statementArena, sizeof(Statement));
+    ans->head = NULL;
+    ans->tail = NULL;
+    ans->count = 0;
+    ans->timed = NOT_TIMED;
+    return ans;
+}
+
+/***
+ * addCommand:
+ *    Add a command to the end of the statement (the node is in the statement arena)
+ *    REFERENCEs are BORROWED
+ ***/
+void addCommand(Statement* stmt, Command* cmd)
+{
+    CmdList* newCmd = arenaAlloc(&statementArena, sizeof(CmdList));
+    newCmd->cmd = cmd;
+    newCmd->next = NULL;
+
+    if (stmt->head == NULL)
+    {
+        // First command
+        stmt->head = stmt->tail = newCmd;
+    }
+    else
+    {
+        stmt->tail = stmt->tail->next = newCmd;
+    }
+    stmt->count++;
+}
+
+/***
+ * exitCode:
+ *    The exit code of a command from its wait status
+ *    (128 + the signal if it was killed by one).
+ ***/
+int exitCode(int waitStatus)
+{
+    if (WIFSIGNALED(waitStatus)) return 128 + WTERMSIG(waitStatus);
+    return WEXITSTATUS(waitStatus);
+}
+
+/***
+ * setPipeStatus:
+ *    Sets PIPESTATUS to the given exit codes - only if they changed, since
+ *    setting any variable throws away the memoized expansions (see expand.h).
+ ***/
+static void setPipeStatus(char* codes)
+{
+    VarEntry* current = findInSet(varList, "PIPESTATUS");
+    if (current == NULL || strcmp(current->value, codes) != 0)
+    {
+        addSpecialToSet(varList, "PIPESTATUS", codes);
+    }
+}
+
+/***
+ * processStatement:
+ *    Execute the (whole, parsed) statement: every command is started
+ *    (each piped into the next), then every one of them is waited for, so
+ *    no stage is left behind as a zombie.
+ *    The exit status is that of the last command.  The exit codes of all
+ *    of them are put in the PIPESTATUS variable (separated by spaces).
+ *    If background is set, the statement is not waited for: it becomes a
+ *    job instead (see jobs.h).
+ *    If any redirect file can not be opened, none of it is run (each
+ *    command's exit code is 1).
+ *    A statement run with TIME has what each command used reported (see timing.h).
+ *    REFERENCEs are BORROWED
+ ***/
+void processStatement(Statement* stmt, int background)
+{
+    assert(stmt != NULL && stmt->head != NULL);
+    reapJobs();   // Finished background jobs (if any)
+    stats.statements++;
+    CmdList* curr;
+
+    // Open all the redirect files first (one that can not be is reported before anything is started)
+    int opened = 1;
+    for (curr = stmt->head; curr != NULL; curr = curr->next)
+    {
+        opened &= openRedirects(curr->cmd);
+    }
+    if (!opened)
+    {
+        // Nothing is run (as if every command exited with 1)
+        char* codes = arenaAlloc(&statementArena, stmt->count * 2);
+        int i;
+        for (curr = stmt->head, i = 0; curr != NULL; curr = curr->next, i++)
+        {
+            closeRedirects(curr->cmd);
+            codes[2 * i] = '1';
+            codes[2 * i + 1] = (curr->next == NULL) ? '\0' : ' ';
+        }
+        if (background) return;
+        status = 1 << 8;
+        if(sFlag == 1) fprintf(stderr, ">> Done: Exit %d\n", status);
+        setPipeStatus(codes);
+        return;
+    }
+
+    // Start all the stages
+    int* children = arenaAlloc(&statementArena, stmt->count * sizeof(int));
+    int* builtinStatuses = arenaAlloc(&statementArena, stmt->count * sizeof(int));
+    int timed = (stmt->timed != NOT_TIMED && !background);
+    StageTime* times = timed ? arenaAlloc(&statementArena, stmt->count * sizeof(StageTime)) : NULL;
+    struct rusage before;
+    double start = timed ? wallClock() : 0;
+    double* launched = arenaAlloc(&statementArena, stmt->count * sizeof(double));  // (For stats.h)
+    int count = 0;
+    int deferred = -1;   // The command put off by the fast path or PARALLEL (if any)
+    for (curr = stmt->head; curr != NULL; curr = curr->next)
+    {
+        launched[count] = wallClock();
+        if (timed)
+        {
+            times[count].start = wallClock();
+            getrusage(RUSAGE_SELF, &before);
+        }
+        children[count] = processCommand(curr->cmd, background);
+        builtinStatuses[count] = builtinStatus;   // (If it was a builtin)
+        if (deferred == -1 && (fastPathPending() || parallelPending())) deferred = count;
+        if (timed && children[count] <= 0)
+        {
+            // Run by the shell itself (done, unless put off)
+            usageSince(&before, &times[count].usage);
+            times[count].end = wallClock();
+        }
+        count++;
+    }
+    if (deferred != -1)
+    {
+        // The rest are running now - so it can go ahead (see fastPath.h, parallel.h)
+        if (timed) getrusage(RUSAGE_SELF, &before);
+        double start = traceClock();
+        int fast = fastPathPending();
+        builtinStatuses[deferred] = fast ? finishFastPath() : finishParallel();
+        traceEvent(fast ? "fastpath" : "builtin", start, fast ? "cat" : "PARALLEL", 0);
+        if (timed)
+        {
+            struct rusage usage;
+            usageSince(&before, &usage);
+            timeradd(&times[deferred].usage.ru_utime, &usage.ru_utime, &times[deferred].usage.ru_utime);
+            timeradd(&times[deferred].usage.ru_stime, &usage.ru_stime, &times[deferred].usage.ru_stime);
+            times[deferred].usage.ru_maxrss = usage.ru_maxrss;
+            times[deferred].usage.ru_nvcsw += usage.ru_nvcsw;
+            times[deferred].usage.ru_nivcsw += usage.ru_nivcsw;
+            times[deferred].end = wallClock();
+        }
+    }
+    for (curr = stmt->head; curr != NULL; curr = curr->next)
+    {
+        closeRedirects(curr->cmd);   // (The commands have their own copies)
+    }
+
+    if (background)
+    {
+        addJob(stmt, children, count);
+        return;
+    }
+
+    // Reap all of them (the statement is only done when they all are)
+    char* codes = arenaAlloc(&statementArena, count * 12 + 1);
+    int length = 0;
+    int i;
+    for (i = 0, curr = stmt->head; i < count; i++, curr = curr->next)
+    {
+        int stageStatus = builtinStatuses[i];   // Builtins
+        if (children[i] > 0)
+        {
+            // Wait for the child to finish (and get what it used, if timed)
+            double waitStart = traceClock();
+            while (wait4(children[i], &stageStatus, 0, timed ? &times[i].usage : NULL) == -1 && errno == EINTR);
+            if (timed) times[i].end = wallClock();
+            recordLatency(wallClock() - launched[i]);
+            traceEvent("wait", waitStart, curr->cmd->command, children[i]);
+            traceProcess(curr->cmd->command, children[i], launched[i] * 1e6);
+        }
+        else if (children[i] < 0)
+        {
+            // Could not be started (as if it exited with 1)
+            stageStatus = 1 << 8;
+        }
+        length += sprintf(codes + length, i == 0 ? "%d" : " %d", exitCode(stageStatus));
+        if (i == count - 1) status = stageStatus;
+        if (timed)
+        {
+            if (children[i] < 0) memset(&times[i].usage, 0, sizeof(struct rusage));
+            if (children[i] < 0) times[i].end = times[i].start;
+            times[i].waitStatus = stageStatus;
+        }
+    }
+
+    if (timed) printTimes(stderr, stmt, times, start, wallClock());
+
+    if(sFlag == 1) fprintf(stderr, ">> Done: Exit %d\n", status);
+    setPipeStatus(codes);
+}
@@ -5,6 +5,8 @@
  *
  * Command
  *    A specific command with a list of arguments.
+ *    A statement is a pipeline of commands (cmd | cmd | ...), each with its
+ *    own redirects.  A whole statement is parsed before any of it is run.
  *******/
 
 #ifndef __COMMAND_H
@@ -12,27 +14,67 @@
 
 #include <stdio.h>
 
+/*
+ * Statements, commands (and their argument lists) are allocated in the
+ * statement arena (see arena.h) and go away when it is reset at the end of
+ * the statement.  Argument, command and file name strings are BORROWED:
+ * either from the line being processed (a token span, see tokenizer.h) or
+ * from the statement arena (if they had to be expanded).
+ */
+
 typedef struct argList
 {
-    char* arg;             // The argument string (REFERENCE is OWNED).
+    char* arg;             // The argument string (REFERENCE is BORROWED).
     struct argList* next;  // The next in the list (REFERENCE is OWNED).
     int tokenType;	 // The type of token the argument is.
 } ArgList;
 
-typedef struct
+typedef struct command
 {
-    char* command;  // The command name itself (REFERENCE is OWNED).
+    char* command;  // The command name itself (REFERENCE is BORROWED).
     ArgList* head;  // The head of the argument list (REFERENCE is OWNED).
     ArgList* tail;  // The tail of the argument list (REFERENCE is BORROWED - part of head's list).
-    enum { STDIN, PIPE_IN, IFILE } input;  // Identifies whether command gets input from stdin, pipe, or file.
-    enum { STDOUT, PIPE_OUT, OFILE, ERRFILE } output;  // Identifies whether command sends output to stdout, pipe, file (output redirect, or error redirect).
+    enum { STDIN, PIPE_IN } input;  // Identifies whether command gets input from stdin or a pipe.
+    enum { STDOUT, PIPE_OUT } output;  // Identifies whether command sends output to stdout or a pipe.
+    char* inFile;   // File to redirect input from, '<' (NULL if none) (REFERENCE is BORROWED).
+    char* outFile;  // File to redirect output to, '>' or '>>' (NULL if none) (REFERENCE is BORROWED).
+    char* errFile;  // File to redirect error to, '>&' (NULL if none) (REFERENCE is BORROWED).
+    int append;     // Whether outFile is appended to ('>>') rather than truncated ('>').
+    int inFd;       // inFile, outFile and errFile once opened (-1 if not)
+    int outFd;      //    (see openRedirects).  A descriptor can also be
+    int errFd;      //    given instead of a file name.
+    struct command* reader;  // The command it pipes into, if PIPE_OUT (REFERENCE is BORROWED).
 } Command;
 
-Command* newCommand(const char* cmd);
-void freeCommand(Command* cmd);
-void printCommand(Command* cmd, FILE* stream);
-int processCommand(Command* cmd);
-void executeCommand(Command* cmd);
-void addArg(Command* cmd, const char* arg, int token);
+/***
+ * A list of commands
+ ***/
+typedef struct cmdList
+{
+    Command* cmd;         // The command (REFERENCE is OWNED)
+    struct cmdList* next; // The next in the list (REFERENCE is OWNED)
+} CmdList;
+
+/***
+ * A statement is a list of commands (piped one into the next)
+ ***/
+typedef struct statement
+{
+    CmdList* head;        // The head of the list of commands (REFERENCE is OWNED)
+    CmdList* tail;        // The tail (for insertion) - REFERENCE is BORROWED - part of head's list
+    int count;            // Number of commands
+    enum { NOT_TIMED, TIME_TEXT, TIME_MACHINE } timed;  // Whether to report its times (TIME, TIME -m - see timing.h)
+} Statement;
+
+Command* newCommand(char* cmd);
+int processCommand(Command* cmd, int background);
+void addArg(Command* cmd, char* arg, int token);
+
+Statement* newStatement();
+void addCommand(Statement* stmt, Command* cmd);
+void processStatement(Statement* stmt, int background);
+int exitCode(int waitStatus);
+void makePipe();
+int openRedirects(Command* cmd);
 
 #endif
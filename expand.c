@@ -0,0 +1,386 @@
+/*******
+ * Dillon Welch
+ *
+ * Expand:
+ *    See expand.h for details.
+ *******/
+
+#include "expand.h"
+#include "varSet.h"
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CACHE 64              // Must be a power of 2.
+#define MAX_CACHED_TEMPLATES 4096     // Cache is emptied when it would hold more.
+
+/***
+ * The state of one token expansion.
+ ***/
+typedef struct
+{
+    VarSet* set;         // The variables (REFERENCE is BORROWED)
+    Arena* arena;        // Where buf is allocated (NULL for malloc)
+    char* buf;           // The expanded string so far (REFERENCE is OWNED)
+    int length;          // Characters in buf
+    int size;            // Characters buf has room for (not counting the '\0')
+    int limit;           // Maximum characters in buf
+    int full;            // Set once something had to be cut off at limit
+    int cycle;           // Slot of a variable found referring to itself (-1 if none)
+} Expansion;
+
+/***
+ * A cached token template (and the hash of its source).
+ ***/
+typedef struct
+{
+    unsigned int hash;
+    Template* tmpl;      // REFERENCE is OWNED (NULL if empty)
+} CacheEntry;
+
+static VarSet* cacheSet = NULL;      // The set the cached templates have slots in
+static CacheEntry* cache = NULL;
+static unsigned int cacheMask = 0;
+static int cacheCount = 0;
+
+static int expandVar(Expansion* ex, int slot, int depth);
+
+/***
+ * compileTemplate:
+ *    Splits text into literal segments and variable references,
+ *    resolving (or reserving) the slot of each variable in set.
+ *    REFERENCE returned is GIVEN
+ ***/
+Template* compileTemplate(VarSet* set, const char* text)
+{
+    Template* tmpl = malloc(sizeof(Template));
+    tmpl->source = strdup(text);
+    tmpl->count = 0;
+    tmpl->literalLength = 0;
+    tmpl->substitutes = 0;
+
+    // There can not be more segments than $'s + 1
+    int dollars = 0;
+    const char* p;
+    for (p = text; *p != '\0'; p++)
+    {
+        if (*p == '$') dollars++;
+    }
+    tmpl->segments = malloc((dollars + 1) * sizeof(Segment));
+
+    p = tmpl->source;
+    while (*p != '\0')
+    {
+        const char* start = strchr(p, '$');
+        const char* end = (start == NULL) ? p + strlen(p) : start;
+        if (end > p)
+        {
+            // Literal text up to the $ (or the end)
+            Segment* seg = &tmpl->segments[tmpl->count++];
+            seg->start = p - tmpl->source;
+            seg->length = end - p;
+            seg->slot = -1;
+            tmpl->literalLength += seg->length;
+        }
+        if (start == NULL) break;
+
+        tmpl->substitutes = 1;
+        end = strchr(start + 1, '$');
+        if (end == NULL)
+        {
+            // Unmatched $ - the rest is dropped
+            break;
+        }
+
+        Segment* seg = &tmpl->segments[tmpl->count++];
+        seg->start = start + 1 - tmpl->source;
+        seg->length = end - start - 1;
+        seg->slot = slotInSet(set, start + 1, end - start - 1);
+        p = end + 1;
+    }
+    return tmpl;
+}
+
+/***
+ * freeTemplate:
+ *    Frees the template (and its OWNED references).
+ *    REFERENCE given is STOLEN (and freed)
+ ***/
+void freeTemplate(Template* tmpl)
+{
+    if (tmpl == NULL) return;
+    free(tmpl->source);
+    free(tmpl->segments);
+    free(tmpl);
+}
+
+/***
+ * emit:
+ *    Append n characters of s to the expansion (as many as fit).
+ *    The buffer only grows if the size estimate was too small.
+ ***/
+static void emit(Expansion* ex, const char* s, int n)
+{
+    if (n > ex->limit - ex->length)
+    {
+        n = ex->limit - ex->length;
+        ex->full = 1;
+    }
+    if (ex->length + n > ex->size)
+    {
+        int oldSize = ex->size;
+        ex->size = ex->size * 2 > ex->length + n ? ex->size * 2 : ex->length + n;
+        if (ex->size > ex->limit) ex->size = ex->limit;
+        if (ex->arena != NULL)
+        {
+            ex->buf = arenaRealloc(ex->arena, ex->buf, oldSize + 1, ex->size + 1);
+        }
+        else
+        {
+            ex->buf = realloc(ex->buf, ex->size + 1);
+        }
+    }
+    memcpy(ex->buf + ex->length, s, n);
+    ex->length += n;
+}
+
+/***
+ * expandAt:
+ *    Append the expansion of tmpl, found after depth substitutions.
+ *    Returns the number of substitution levels the text needed (its height),
+ *    or -1 if the result is incomplete (level cap reached, a cycle, or cut off)
+ *    and so must not be memoized.
+ ***/
+static int expandAt(Expansion* ex, Template* tmpl, int depth)
+{
+    if (depth >= MAX_SUBSTITUTION_LEVEL)
+    {
+        // Out of levels - text is left exactly as it is.
+        emit(ex, tmpl->source, strlen(tmpl->source));
+        return (ex->full || tmpl->substitutes) ? -1 : 0;
+    }
+
+    int height = tmpl->substitutes;  // At least one level is needed if there is a $
+    int incomplete = 0;
+    int i;
+    for (i = 0; i < tmpl->count && !ex->full; i++)
+    {
+        Segment* seg = &tmpl->segments[i];
+        if (seg->slot < 0)
+        {
+            emit(ex, tmpl->source + seg->start, seg->length);
+        }
+        else if (ex->set->entries[seg->slot].value != NULL)
+        {
+            // No error if the variable is not set (it is just empty)
+            int h = expandVar(ex, seg->slot, depth + 1);
+            if (h < 0) incomplete = 1;
+            else if (h + 1 > height) height = h + 1;
+        }
+    }
+
+    return (incomplete || ex->full) ? -1 : height;
+}
+
+/***
+ * memoValid:
+ *    Whether the memoized expansion of var can be used at the given depth
+ *    (it must be current, and not have needed more levels than are left).
+ ***/
+static int memoValid(VarSet* set, VarEntry* var, int depth)
+{
+    return var->expansion != NULL && var->memoGeneration == set->generation &&
+           depth + var->height <= MAX_SUBSTITUTION_LEVEL;
+}
+
+/***
+ * expandVar:
+ *    Append the expansion of the value in the given slot, found at the given depth.
+ *    Uses (and fills in) the memo in the entry when possible.
+ *    Returns the height of the expansion or -1 (see expandAt).
+ ***/
+static int expandVar(Expansion* ex, int slot, int depth)
+{
+    VarEntry* var = &ex->set->entries[slot];
+    if (memoValid(ex->set, var, depth))
+    {
+        // Already known
+        stats.memoHits++;
+        emit(ex, var->expansion, var->expansionLength);
+        return ex->full ? -1 : var->height;
+    }
+
+    if (var->expanding && ex->cycle < 0)
+    {
+        ex->cycle = slot;  // Refers to itself: expand up to the level cap, never memoize.
+    }
+
+    if (var->tmpl == NULL)
+    {
+        // First use of this value.  (Compiling may reserve slots - and move entries.)
+        Template* tmpl = compileTemplate(ex->set, var->value);
+        var = &ex->set->entries[slot];
+        var->tmpl = tmpl;
+    }
+
+    stats.substitutions++;
+    int start = ex->length;
+    var->expanding++;
+    int height = expandAt(ex, var->tmpl, depth);
+    var = &ex->set->entries[slot];   // (Nested values may have been compiled too.)
+    var->expanding--;
+
+    if (height >= 0 && !var->expanding)
+    {
+        // A complete expansion - remember it
+        free(var->expansion);
+        var->expansion = strndup(ex->buf + start, ex->length - start);
+        var->expansionLength = ex->length - start;
+        var->height = height;
+        var->memoGeneration = ex->set->generation;
+    }
+    return height;
+}
+
+/***
+ * expandTemplate:
+ *    Returns the expansion of the compiled text using the variables in set.
+ *    REFERENCE returned is GIVEN (or BORROWED from arena, if not NULL)
+ ***/
+char* expandTemplate(VarSet* set, Template* tmpl, Arena* arena)
+{
+    Expansion ex;
+    ex.set = set;
+    ex.arena = arena;
+    ex.length = 0;
+    ex.limit = MAX_EXPANSION_LENGTH;
+    ex.full = 0;
+    ex.cycle = -1;
+
+    // Size the buffer from the literals and the (memoized) values
+    ex.size = tmpl->literalLength;
+    int i;
+    for (i = 0; i < tmpl->count; i++)
+    {
+        VarEntry* var = tmpl->segments[i].slot < 0 ? NULL : &set->entries[tmpl->segments[i].slot];
+        if (var == NULL || var->value == NULL) continue;
+        ex.size += memoValid(set, var, 1) ? var->expansionLength : strlen(var->value);
+    }
+    if (ex.size > ex.limit) ex.size = ex.limit;
+    ex.buf = (arena != NULL) ? arenaAlloc(arena, ex.size + 1) : malloc(ex.size + 1);
+
+    expandAt(&ex, tmpl, 0);
+    ex.buf[ex.length] = '\0';   // Terminate our (expanded) string copy
+
+    if (ex.cycle >= 0)
+    {
+        fprintf(stderr, "Warning: variable %s refers to itself (stopped after %d levels)\n",
+                set->entries[ex.cycle].name, MAX_SUBSTITUTION_LEVEL);
+    }
+    if (ex.full)
+    {
+        fprintf(stderr, "Warning: expansion of %.20s... cut off at %d characters\n",
+                tmpl->source, MAX_EXPANSION_LENGTH);
+    }
+    return ex.buf;
+}
+
+/***
+ * clearTemplateCache:
+ *    Frees all cached token templates.
+ ***/
+void clearTemplateCache()
+{
+    unsigned int i;
+    for (i = 0; cache != NULL && i <= cacheMask; i++)
+    {
+        freeTemplate(cache[i].tmpl);
+    }
+    free(cache);
+    cache = NULL;
+    cacheMask = 0;
+    cacheCount = 0;
+    cacheSet = NULL;
+}
+
+/***
+ * cachedTemplate:
+ *    Returns the compiled token (compiling and caching it the first time).
+ *    REFERENCE returned is BORROWED (owned by the cache)
+ ***/
+static Template* cachedTemplate(VarSet* set, const char* token)
+{
+    if (cacheSet != set || cacheCount >= MAX_CACHED_TEMPLATES)
+    {
+        // Start over (slots only mean something in one set)
+        clearTemplateCache();
+        cacheSet = set;
+        cacheMask = INITIAL_CACHE - 1;
+        cache = calloc(INITIAL_CACHE, sizeof(CacheEntry));
+    }
+
+    unsigned int hash = hashString(token, strlen(token));
+    unsigned int i = hash & cacheMask;
+    while (cache[i].tmpl != NULL)
+    {
+        if (cache[i].hash == hash && strcmp(cache[i].tmpl->source, token) == 0)
+        {
+            return cache[i].tmpl;
+        }
+        i = (i + 1) & cacheMask;
+    }
+
+    cache[i].hash = hash;
+    cache[i].tmpl = compileTemplate(set, token);
+    Template* tmpl = cache[i].tmpl;
+
+    if (++cacheCount * 2 > cacheMask + 1)
+    {
+        // Keep the cache at most half full
+        unsigned int oldMask = cacheMask;
+        CacheEntry* old = cache;
+        cacheMask = cacheMask * 2 + 1;
+        cache = calloc(cacheMask + 1, sizeof(CacheEntry));
+        for (i = 0; i <= oldMask; i++)
+        {
+            if (old[i].tmpl == NULL) continue;
+            unsigned int j = old[i].hash & cacheMask;
+            while (cache[j].tmpl != NULL) j = (j + 1) & cacheMask;
+            cache[j] = old[i];
+        }
+        free(old);
+    }
+    return tmpl;
+}
+
+/***
+ * expandToken:
+ *    Returns the expansion of token using the variables in set.
+ *    REFERENCE returned is GIVEN (or BORROWED from arena, if not NULL)
+ ***/
+char* expandToken(VarSet* set, const char* token, Arena* arena)
+{
+    if (strchr(token, '$') == NULL)
+    {
+        // Nothing to substitute
+        return (arena != NULL) ? arenaStrndup(arena, token, strlen(token)) : strdup(token);
+    }
+    stats.expansions++;
+    return expandTemplate(set, cachedTemplate(set, token), arena);
+}
+
+/***
+ * preprocess:
+ *    See expand.h.  (Traced as an expand event - see trace.h.)
+ ***/
+char* preprocess(VarSet* set, char* token, int *changeFlag, Arena* arena)
+{
+    double start = traceClock();
+    *changeFlag = (strchr(token, '$') != NULL);
+    char* expanded = expandToken(set, token, arena);
+    traceEvent("expand", start, token, 0);
+    return expanded;
+}
@@ -0,0 +1,96 @@
+/*******
+ * Dillon Welch
+ *
+ * Expand:
+ *    Variable substitution for BASIC and DOUBLE_QUOTE tokens.
+ *    (SINGLE_QUOTE tokens are never expanded - they are taken as is.)
+ *
+ *    Every $name$ in a token is replaced by the value of the variable name
+ *    (nothing if it is not set).  The value is itself expanded the same way,
+ *    so a token is fully expanded in a single pass over it:
+ *       set word 'Good $bye$'
+ *       set bye "Bye Bye"
+ *       echo "Hello $word$"     prints   Hello Good Bye Bye
+ *
+ *    A $ without a matching $ ends the token (the rest of it is dropped).
+ *
+ *    Templates:
+ *       Text is compiled once into a Template: a list of literal segments
+ *       and variable references, each reference resolved to the variable's
+ *       slot in the VarSet (see varSet.h).  Expanding a template only copies
+ *       segments into one buffer sized from the literals and memoized values.
+ *       Compiled tokens are cached by their text (so replayed lines skip the
+ *       scan), and a variable's value is compiled the first time it is used.
+ *
+ *    Recursion:
+ *       Substitutions nest at most MAX_SUBSTITUTION_LEVEL deep.  Text that is
+ *       reached after that many levels is left exactly as it is, so
+ *          set rec 'X$rec$'
+ *          echo $rec$           prints   XXXXXXXXXX$rec$
+ *       A variable that (directly or not) refers to itself is detected while
+ *       it is being expanded and reported once per token on stderr.
+ *
+ *    Memoization:
+ *       The full expansion of each variable is remembered in its VarSet entry
+ *       and reused by later tokens until any variable is SET again.
+ *
+ *    Length:
+ *       The expansion buffer grows as needed - there is no fixed line or
+ *       token size.  Only runaway expansions (every level doubling, say) are
+ *       cut off at MAX_EXPANSION_LENGTH characters, with a warning on stderr.
+ *******/
+
+#ifndef __EXPAND_H
+#define __EXPAND_H
+
+#include "varSet.h"
+#include "arena.h"
+
+#define MAX_SUBSTITUTION_LEVEL 10
+#define MAX_EXPANSION_LENGTH (64 * 1024 * 1024)
+
+/***
+ * A piece of a template: either literal text or a variable reference.
+ ***/
+typedef struct segment
+{
+    int start;   // Offset of the literal text in the template's source
+    int length;  // Length of the literal text
+    int slot;    // Slot of the variable in the VarSet (-1 for literal text)
+} Segment;
+
+typedef struct template
+{
+    char* source;        // The text compiled (REFERENCE is OWNED)
+    Segment* segments;   // The pieces, in order (REFERENCE is OWNED)
+    int count;           // Number of segments
+    int literalLength;   // Total length of the literal segments
+    int substitutes;     // 1 if the text has any $ at all (needs a level to expand)
+} Template;
+
+Template* compileTemplate(VarSet* set, const char* text);  // REFERENCE returned is GIVEN
+void freeTemplate(Template* tmpl);
+char* expandTemplate(VarSet* set, Template* tmpl, Arena* arena);
+void clearTemplateCache();
+
+/***
+ * expandToken:
+ *    Returns the expansion of token using the variables in set.
+ *    (The compiled token is cached.)
+ *    The result is allocated in arena (REFERENCE returned is BORROWED until the
+ *    arena is reset), or with malloc if arena is NULL (REFERENCE returned is GIVEN).
+ *    expandTemplate is the same for an already compiled text.
+ ***/
+char* expandToken(VarSet* set, const char* token, Arena* arena);
+
+/***
+ * preprocess:
+ *   Takes a given token and does variable replacement (if needed), with
+ *   the variables in set.
+ *   Returns a string representing the fully expanded string.
+ *      Sets changeFlag to 1 if the token had anything to substitute and 0 otherwise
+ *   REFERENCE returned is BORROWED (from arena - until it is reset)
+ ***/
+char* preprocess(VarSet* set, char* token, int *changeFlag, Arena* arena);
+
+#endif
@@ -0,0 +1,486 @@
+/*******
+ * Dillon Welch
+ *
+ * Fast Path:
+ *    See fastPath.h for details.
+ *******/
+
+#define _GNU_SOURCE
+#include "fastPath.h"
+#include "global.h"
+#include "arena.h"
+#include "builtins.h"
+#include "parallel.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#define COPY_BLOCK (64 * 1024)
+#define MOVE_BLOCK (1024 * 1024)   // Most bytes moved in the kernel at once
+#define CANNOT_RUN -1   // From a command: it has to be launched after all
+
+static int fastEcho(char** args, int in, int out, int err);
+static int fastCat(char** args, int in, int out, int err);
+static int fastTrue(char** args, int in, int out, int err);
+static int fastFalse(char** args, int in, int out, int err);
+
+static char *fastNames[] = { "echo", "cat", "true", "false", NULL };
+static int (*fastFn[])(char**, int, int, int) = { fastEcho, fastCat, fastTrue, fastFalse, NULL };
+
+/***
+ * A cat into a pipe, put off until the rest of the statement is started.
+ * (Its descriptors are its own, and close-on-exec, so no command started
+ * in the meantime holds on to them.)
+ ***/
+static struct
+{
+    int pending;
+    char** args;   // REFERENCE is BORROWED (statement arena)
+    int in;
+    int out;       // (Its own copy of the pipe)
+    int err;
+    int ownIn;     // Whether in is its own copy (of a pipe) - or a redirect file
+} deferred;
+
+/***
+ * fastPathOn:
+ *    Whether the in-process commands are used (not SET FASTPATH 0/off).
+ ***/
+static int fastPathOn()
+{
+    VarEntry* mode = findInSet(varList, "FASTPATH");
+    return mode == NULL || (strcmp(mode->value, "0") != 0 && strcasecmp(mode->value, "off") != 0);
+}
+
+/***
+ * writeAll:
+ *    Writes all length bytes to fd.
+ *    Returns 0, or the errno it failed with.
+ ***/
+static int writeAll(int fd, const char* buffer, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t put = write(fd, buffer, length);
+        if (put == -1 && errno == EINTR) continue;
+        if (put == -1) return errno;
+        buffer += put;
+        length -= put;
+    }
+    return 0;
+}
+
+/***
+ * writeStatus:
+ *    The wait status for a command whose writing failed with error: killed
+ *    by SIGPIPE if the reader is gone (as it would have been), else exit 1.
+ ***/
+static int writeStatus(int error, int err)
+{
+    if (error == EPIPE) return SIGPIPE;
+    dprintf(err, "write error: %s\n", strerror(error));
+    return 1 << 8;
+}
+
+/***
+ * isEchoOption:
+ *    Whether arg is echo options (-n, -e, -E, or several of them: -ne).
+ ***/
+static int isEchoOption(const char* arg)
+{
+    return arg[0] == '-' && arg[1] != '\0' && strspn(arg + 1, "neE") == strlen(arg + 1);
+}
+
+/***
+ * echoEscape:
+ *    Appends the character for the escape after a '\' at *s (echo -e),
+ *    moving *s past it.  Returns 0 for \c (no more output at all).
+ ***/
+static int echoEscape(const char** s, char** p)
+{
+    const char* c = *s;
+    int value;
+    switch (*c++)
+    {
+    case 'a': value = '\a'; break;
+    case 'b': value = '\b'; break;
+    case 'c': return 0;
+    case 'e': value = 0x1B; break;
+    case 'f': value = '\f'; break;
+    case 'n': value = '\n'; break;
+    case 'r': value = '\r'; break;
+    case 't': value = '\t'; break;
+    case 'v': value = '\v'; break;
+    case '\\': value = '\\'; break;
+    case 'x':
+        if (!isxdigit((unsigned char) *c))
+        {
+            *(*p)++ = '\\';
+            value = 'x';
+            break;
+        }
+        value = 0;
+        int digits;
+        for (digits = 0; digits < 2 && isxdigit((unsigned char) *c); digits++, c++)
+        {
+            value = value * 16 + (isdigit((unsigned char) *c) ? *c - '0' : (tolower((unsigned char) *c) - 'a' + 10));
+        }
+        break;
+    case '0':
+    case '1': case '2': case '3': case '4': case '5': case '6': case '7':
+        // \0NNN or \NNN (octal, up to 3 digits after any leading 0)
+        value = c[-1] - '0';
+        int octal;
+        if (value == 0 && *c >= '0' && *c <= '7') value = *c++ - '0';
+        for (octal = 0; octal < 2 && *c >= '0' && *c <= '7'; octal++) value = value * 8 + (*c++ - '0');
+        break;
+    default:
+        // Not an escape - kept as it is
+        *(*p)++ = '\\';
+        c--;
+        value = *c++;
+        break;
+    }
+    *(*p)++ = (char) value;
+    *s = c;
+    return 1;
+}
+
+/***
+ * fastEcho:
+ *    echo [-neE] args... (as coreutils echo).
+ *    The whole line is built first, and written in one go.
+ ***/
+static int fastEcho(char** args, int in, int out, int err)
+{
+    if (args[1] != NULL && args[2] == NULL && (strcmp(args[1], "--help") == 0 || strcmp(args[1], "--version") == 0))
+    {
+        return CANNOT_RUN;
+    }
+
+    int newline = 1;
+    int escapes = 0;
+    char** arg = args + 1;
+    for ( ; *arg != NULL && isEchoOption(*arg); arg++)
+    {
+        const char* o;
+        for (o = *arg + 1; *o != '\0'; o++)
+        {
+            if (*o == 'n') newline = 0;
+            else escapes = (*o == 'e');
+        }
+    }
+
+    size_t length = 1;
+    char** a;
+    for (a = arg; *a != NULL; a++) length += strlen(*a) + 1;
+    char* line = arenaAlloc(&statementArena, length);
+    char* p = line;
+    for (a = arg; *a != NULL; a++)
+    {
+        if (a != arg) *p++ = ' ';
+        const char* s = *a;
+        while (*s != '\0')
+        {
+            if (escapes && *s == '\\' && s[1] != '\0')
+            {
+                s++;
+                if (!echoEscape(&s, &p))
+                {
+                    newline = 0;   // \c - nothing more
+                    goto done;
+                }
+            }
+            else *p++ = *s++;
+        }
+    }
+done:
+    if (newline) *p++ = '\n';
+
+    int error = writeAll(out, line, p - line);
+    return error == 0 ? 0 : writeStatus(error, err);
+}
+
+/***
+ * copyFd:
+ *    Copies everything from in to out through a buffer (read/write).
+ *    Returns 0, or -errno if reading failed or errno if writing did.
+ ***/
+static int copyFd(int in, int out)
+{
+    char buffer[COPY_BLOCK];
+    for (;;)
+    {
+        ssize_t got = read(in, buffer, sizeof(buffer));
+        if (got == -1 && errno == EINTR) continue;
+        if (got == -1) return -errno;
+        if (got == 0) return 0;
+        int error = writeAll(out, buffer, got);
+        if (error != 0) return error;
+    }
+}
+
+/***
+ * moveData:
+ *    Moves everything from in to out without copying it through the shell:
+ *    splice if either one is a pipe (pages are passed along, not copied),
+ *    else sendfile from a regular file.  Falls back to copyFd if the kernel
+ *    can do neither for these two (a terminal, say).
+ *    Returns 0, or -errno if reading failed or errno if writing did
+ *    (which one it was is not known - EPIPE is taken to be writing).
+ ***/
+static int moveData(int in, int out)
+{
+    struct stat inInfo;
+    struct stat outInfo;
+    if (fstat(in, &inInfo) == -1 || fstat(out, &outInfo) == -1) return copyFd(in, out);
+
+    int useSplice = S_ISFIFO(inInfo.st_mode) || S_ISFIFO(outInfo.st_mode);
+    if (!useSplice && !S_ISREG(inInfo.st_mode)) return copyFd(in, out);
+
+    off_t moved = 0;
+    for (;;)
+    {
+        ssize_t done = useSplice ? splice(in, NULL, out, NULL, MOVE_BLOCK, SPLICE_F_MOVE | SPLICE_F_MORE)
+                                 : sendfile(out, in, NULL, MOVE_BLOCK);
+        if (done == -1 && errno == EINTR) continue;
+        if (done == -1 && moved == 0 && (errno == EINVAL || errno == ENOSYS)) return copyFd(in, out);
+        if (done == -1) return errno == EPIPE ? EPIPE : -errno;
+        if (done == 0) return 0;
+        moved += done;
+    }
+}
+
+/***
+ * catOptions:
+ *    Whether cat was given any options (so it can not be done here).
+ ***/
+static int catOptions(char** args)
+{
+    char** arg;
+    for (arg = args + 1; *arg != NULL; arg++)
+    {
+        if ((*arg)[0] == '-' && (*arg)[1] != '\0') return 1;
+    }
+    return 0;
+}
+
+/***
+ * fastCat:
+ *    cat [file|-]... (as coreutils cat, with no options).
+ *    The data is moved by the kernel where it can be (see moveData).
+ ***/
+static int fastCat(char** args, int in, int out, int err)
+{
+    if (catOptions(args)) return CANNOT_RUN;
+
+    char** arg;
+    char* stdinOnly[] = { "-", NULL };
+    int status = 0;
+    for (arg = args[1] == NULL ? stdinOnly : args + 1; *arg != NULL; arg++)
+    {
+        int file = in;
+        if (strcmp(*arg, "-") != 0)
+        {
+            file = open(*arg, O_RDONLY | O_CLOEXEC);
+            if (file == -1)
+            {
+                dprintf(err, "cat: %s: %s\n", *arg, strerror(errno));
+                status = 1 << 8;
+                continue;
+            }
+        }
+
+        int error = moveData(file, out);
+        if (file != in) close(file);
+        if (error > 0) return writeStatus(error, err);
+        if (error < 0)
+        {
+            dprintf(err, "cat: %s: %s\n", *arg, strerror(-error));
+            status = 1 << 8;
+        }
+    }
+    return status;
+}
+
+/***
+ * fastTrue:
+ *    true (does nothing, successfully).
+ ***/
+static int fastTrue(char** args, int in, int out, int err)
+{
+    if (args[1] != NULL && args[2] == NULL && strncmp(args[1], "--", 2) == 0) return CANNOT_RUN;
+    return 0;
+}
+
+/***
+ * fastFalse:
+ *    false (does nothing, unsuccessfully).
+ ***/
+static int fastFalse(char** args, int in, int out, int err)
+{
+    if (args[1] != NULL && args[2] == NULL && strncmp(args[1], "--", 2) == 0) return CANNOT_RUN;
+    return 1 << 8;
+}
+
+/***
+ * fitsInPipe:
+ *    Whether echo's output (args from index 1) is sure to fit in the pipe.
+ ***/
+static int fitsInPipe(char** args, int pipe)
+{
+    size_t length = 1;
+    char** a;
+    for (a = args + 1; *a != NULL; a++) length += strlen(*a) + 1;
+    int size = fcntl(pipe, F_GETPIPE_SZ);
+    return length <= (size_t) (size > 0 ? size : PIPE_BUF);
+}
+
+/***
+ * runsInShell:
+ *    Whether the command would be run by the shell itself (a builtin, or
+ *    maybe a fast path one) rather than launched.
+ ***/
+static int runsInShell(Command* cmd)
+{
+    if (isBuiltin(cmd->command)) return 1;
+    int i;
+    for (i = 0; fastNames[i] != NULL; i++)
+    {
+        if (strcmp(cmd->command, fastNames[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+/***
+ * canDefer:
+ *    Whether a cat piping into reader can be put off until the rest of the
+ *    statement is started: only if all of the rest is to be launched (the
+ *    shell can not be waiting on the pipe - directly or through commands
+ *    in between - while it is the one to write it).
+ ***/
+static int canDefer(Command* reader)
+{
+    if (reader == NULL || deferred.pending) return 0;
+    for ( ; reader != NULL; reader = reader->reader)
+    {
+        if (runsInShell(reader)) return 0;
+    }
+    return 1;
+}
+
+/***
+ * runFast:
+ *    Runs fast path command i on the given descriptors.
+ *    A reader that went away is reported to it as EPIPE (SIGPIPE would
+ *    kill the shell itself).
+ *    Returns its wait status (or CANNOT_RUN).
+ ***/
+static int runFast(int i, char** args, int in, int out, int err)
+{
+    fflush(stdout);
+    struct sigaction ignore;
+    struct sigaction saved;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &saved);
+    int status = (fastFn[i])(args, in, out, err);
+    sigaction(SIGPIPE, &saved, NULL);
+    return status;
+}
+
+/***
+ * processFastPath:
+ *    Runs the command in the shell itself if it is one of the fast path
+ *    commands (and can be - see fastPath.h), with its pipes and redirects.
+ *    args: its argument array (REFERENCE is BORROWED - must last the statement)
+ *    inputPipe: the pipe it reads from if its input is PIPE_IN (the one it
+ *    writes to is comm[1], already made).  The caller still closes both.
+ *    builtinStatus is set to its wait status.
+ *
+ *    A cat into a pipe is not run yet (the command reading the pipe is not
+ *    started) - it is put off until finishFastPath, once the statement's
+ *    other commands are running (if they are all launched - see canDefer).
+ *    Otherwise the cat is launched.
+ *    Nothing is run in the shell for a background statement (background
+ *    set): the shell would have to finish it before going on.
+ *    Returns 1 if it was run (or put off), 0 if it has to be launched as usual.
+ ***/
+int processFastPath(Command* cmd, char** args, int inputPipe, int background)
+{
+    int i;
+    for (i = 0; fastNames[i] != NULL; i++)
+    {
+        if (strcmp(cmd->command, fastNames[i]) == 0) break;
+    }
+    if (fastNames[i] == NULL || !fastPathOn() || background) return 0;
+    if (fastFn[i] == fastCat && parallelPending()) return 0;   // (Reading what PARALLEL holds back)
+
+    // Writing into a pipe to a command that is not started yet
+    int toPipe = (cmd->output == PIPE_OUT && cmd->outFile == NULL);
+    int defer = toPipe && fastFn[i] == fastCat;
+    if (defer && (catOptions(args) || !canDefer(cmd->reader))) return 0;
+    if (toPipe && fastFn[i] == fastEcho && !fitsInPipe(args, comm[1])) return 0;
+
+    // Descriptors as the launched command would have them (files - opened
+    //    already, see openRedirects - win over pipes)
+    int in = cmd->inFd != -1 ? cmd->inFd : cmd->input == PIPE_IN ? inputPipe : 0;
+    int out = cmd->outFd != -1 ? cmd->outFd : cmd->output == PIPE_OUT ? comm[1] : 1;
+    int err = cmd->errFd != -1 ? cmd->errFd : 2;
+
+    if (defer)
+    {
+        // Keep its own copies of the pipe ends (the caller closes these)
+        //    The files stay open until the statement is done.
+        deferred.pending = 1;
+        deferred.args = args;
+        deferred.ownIn = (cmd->inFd == -1 && cmd->input == PIPE_IN);
+        deferred.in = deferred.ownIn ? fcntl(inputPipe, F_DUPFD_CLOEXEC, 3) : in;
+        deferred.out = fcntl(out, F_DUPFD_CLOEXEC, 3);
+        deferred.err = err;
+        builtinStatus = 0;   // (For now - see finishFastPath)
+        return 1;
+    }
+
+    int status = runFast(i, args, in, out, err);
+    if (status == CANNOT_RUN) return 0;
+    builtinStatus = status;
+    return 1;
+}
+
+/***
+ * fastPathPending:
+ *    Whether a command was put off by processFastPath (not yet finished).
+ ***/
+int fastPathPending()
+{
+    return deferred.pending;
+}
+
+/***
+ * finishFastPath:
+ *    Runs the command put off by processFastPath (if any), now that the
+ *    commands it pipes into are started.
+ *    Returns its wait status.
+ ***/
+int finishFastPath()
+{
+    if (!deferred.pending) return 0;
+    deferred.pending = 0;
+
+    int i;
+    for (i = 0; fastFn[i] != fastCat; i++);
+    int status = runFast(i, deferred.args, deferred.in, deferred.out, deferred.err);
+
+    if (deferred.ownIn) close(deferred.in);
+    close(deferred.out);
+    return status;
+}
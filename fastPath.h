@@ -0,0 +1,43 @@
+/*******
+ * Dillon Welch
+ *
+ * Fast Path:
+ *    In-process versions of the commands scripts run the most - echo, cat,
+ *    true and false - so running one does not cost a process launch.
+ *
+ *    They are looked up like the builtins (a table of names and functions),
+ *    but only after them, and only by their exact (lower case) names.  They
+ *    behave like the coreutils commands they stand in for (echo -n/-e/-E,
+ *    cat of files and "-"), with the same pipes and <, >, >& redirects;
+ *    the exit code is their status, just as if they had been run.
+ *
+ *    cat does not copy the data through the shell: it is spliced (to or from
+ *    a pipe) or sendfile'd (from a file), so it goes from kernel buffer to
+ *    kernel buffer (only a terminal, say, gets read and write).  A cat
+ *    piping into a later command is run last, once the rest of the
+ *    statement is started (the reader has to be running, or cat could fill
+ *    the pipe and wait forever).
+ *
+ *    A command is still launched as usual when it could not be done right
+ *    in the shell:
+ *       - any option they do not support (cat -n, --help, ...)
+ *       - cat piping into a command the shell runs itself (a builtin, or
+ *         another of these), now or further down the pipeline
+ *       - anything in a statement run in the background (cat of a FIFO or
+ *         a huge file, or into a slow reader, would hold up the shell)
+ *       - cat after a PARALLEL whose output is held back (see parallel.h)
+ *       - echo output that does not fit in the pipe to a later command
+ *
+ *    SET FASTPATH 0 (or off) turns them off - every command is launched.
+ *******/
+
+#ifndef __FAST_PATH_H
+#define __FAST_PATH_H
+
+#include "command.h"
+
+int processFastPath(Command* cmd, char** args, int inputPipe, int background);
+int fastPathPending();
+int finishFastPath();
+
+#endif
@@ -8,21 +8,14 @@
  *******/
 
 #include "varSet.h"
+#include "arena.h"
 
 // These variables must be defined elsewhere, these are just declarations.
 
 extern VarSet* varList; // Variable list
-int comm[2]; // For piping
-int status;  // Exit status.
-int sFlag;   // Whether to print status or not.
-char *dir;   // Current directory.
-char *t;     // Tilde (for truncating directory with ~/).
-
-int ioFlag;     // Redirect flags.
-int inputFlag;
-int outputFlag;
-int errorFlag;
-
-char *input;  // The names of the files for input, output, and error redirection.
-char *output;
-char *error;
+extern Arena statementArena; // Memory for the statement being processed (reset after each one)
+extern int comm[2]; // For piping
+extern int status;  // Exit status.
+extern int builtinStatus;  // Wait status of the last builtin run (0 unless it failed).
+extern int sFlag;   // Whether to print status or not.
+extern char *dir;   // Current directory, as shown in the prompt (~ for HOME) - see findDir.
@@ -0,0 +1,241 @@
+/*******
+ * Dillon Welch
+ *
+ * Jobs:
+ *    See jobs.h for details.
+ *******/
+
+#include "jobs.h"
+#include "command.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#define MAX_DONE_JOBS 256   // Finished jobs kept (for JOBS) before the oldest are dropped
+
+static Job** jobs = NULL;     // The jobs, oldest first (REFERENCEs are OWNED)
+static int jobCount = 0;
+static int jobCapacity = 0;
+
+static volatile sig_atomic_t childExited = 0;  // Set by SIGCHLD (some child may need reaping)
+
+/***
+ * onChild:
+ *    SIGCHLD handler - just notes that there is something to reap.
+ ***/
+static void onChild(int sig)
+{
+    childExited = 1;
+}
+
+/***
+ * initJobs:
+ *    Start catching SIGCHLD.  (System calls it interrupts are restarted.)
+ ***/
+void initJobs()
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onChild;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, NULL);
+}
+
+/***
+ * statementText:
+ *    The statement as text: its commands and arguments, piped.
+ *    REFERENCE returned is GIVEN
+ ***/
+static char* statementText(Statement* stmt)
+{
+    size_t length = 1;
+    CmdList* curr;
+    ArgList* arg;
+    for (curr = stmt->head; curr != NULL; curr = curr->next)
+    {
+        length += strlen(curr->cmd->command) + 3;
+        for (arg = curr->cmd->head; arg != NULL; arg = arg->next) length += strlen(arg->arg) + 1;
+    }
+
+    char* text = malloc(length);
+    char* p = text;
+    for (curr = stmt->head; curr != NULL; curr = curr->next)
+    {
+        p += sprintf(p, "%s%s", curr == stmt->head ? "" : " | ", curr->cmd->command);
+        for (arg = curr->cmd->head; arg != NULL; arg = arg->next) p += sprintf(p, " %s", arg->arg);
+    }
+    *p = '\0';
+    return text;
+}
+
+/***
+ * addJob:
+ *    Add the (started) statement to the table.
+ *    pids: the process of each command (0 for a builtin, -1 if it could not
+ *          be started) (REFERENCE is BORROWED - copied)
+ *    REFERENCE returned is BORROWED (until the job is waited for or listed done)
+ ***/
+Job* addJob(Statement* stmt, int* pids, int count)
+{
+    if (jobCount == jobCapacity)
+    {
+        jobCapacity = jobCapacity == 0 ? 8 : jobCapacity * 2;
+        jobs = realloc(jobs, jobCapacity * sizeof(Job*));
+    }
+
+    Job* job = malloc(sizeof(Job));
+    job->id = jobCount == 0 ? 1 : jobs[jobCount - 1]->id + 1;
+    job->pids = malloc(count * sizeof(int));
+    job->statuses = malloc(count * sizeof(int));
+    job->count = count;
+    job->running = 0;
+    job->text = statementText(stmt);
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        job->pids[i] = pids[i];
+        if (pids[i] > 0)
+        {
+            job->statuses[i] = -1;   // Not done yet
+            job->running++;
+        }
+        else
+        {
+            job->statuses[i] = (pids[i] < 0) ? 1 << 8 : 0;   // Could not start / builtin
+        }
+    }
+
+    jobs[jobCount++] = job;
+    return job;
+}
+
+/***
+ * reap:
+ *    Reap whichever processes of the job are done (waiting for all of them if block).
+ ***/
+static void reap(Job* job, int block)
+{
+    int i;
+    for (i = 0; i < job->count && job->running > 0; i++)
+    {
+        if (job->statuses[i] != -1) continue;
+
+        int status;
+        int done;
+        while ((done = waitpid(job->pids[i], &status, block ? 0 : WNOHANG)) == -1 && errno == EINTR);
+        if (done == 0) continue;          // Still running
+        if (done == -1) status = 0;       // Already gone (nothing to report)
+        job->statuses[i] = status;
+        job->running--;
+    }
+}
+
+/***
+ * removeJob:
+ *    Drop job i from the table (and free it).
+ ***/
+static void removeJob(int i)
+{
+    free(jobs[i]->pids);
+    free(jobs[i]->statuses);
+    free(jobs[i]->text);
+    free(jobs[i]);
+    memmove(jobs + i, jobs + i + 1, (jobCount - i - 1) * sizeof(Job*));
+    jobCount--;
+}
+
+/***
+ * reapJobs:
+ *    Reap any finished processes of the jobs (never blocks).
+ *    Does nothing unless a SIGCHLD came in since the last time.
+ *    (So scripts that never list their jobs do not keep them all, only
+ *    the last MAX_DONE_JOBS finished ones are kept.)
+ ***/
+void reapJobs()
+{
+    if (!childExited) return;
+    childExited = 0;
+
+    int i;
+    int done = 0;
+    for (i = 0; i < jobCount; i++)
+    {
+        if (jobs[i]->running > 0) reap(jobs[i], 0);
+        if (jobs[i]->running == 0) done++;
+    }
+
+    for (i = 0; i < jobCount && done > MAX_DONE_JOBS; )
+    {
+        if (jobs[i]->running == 0)
+        {
+            removeJob(i);
+            done--;
+        }
+        else i++;
+    }
+}
+
+/***
+ * printJobs:
+ *    List the jobs: running, or done (with the exit code of each command).
+ *    Done jobs are dropped once listed.
+ ***/
+void printJobs(FILE* stream)
+{
+    reapJobs();
+
+    int i = 0;
+    while (i < jobCount)
+    {
+        Job* job = jobs[i];
+        if (job->running > 0)
+        {
+            fprintf(stream, "[%d] Running  %s\n", job->id, job->text);
+            i++;
+            continue;
+        }
+
+        fprintf(stream, "[%d] Done (exit", job->id);
+        int j;
+        for (j = 0; j < job->count; j++) fprintf(stream, " %d", exitCode(job->statuses[j]));
+        fprintf(stream, ")  %s\n", job->text);
+        removeJob(i);
+    }
+}
+
+/***
+ * waitJob:
+ *    Wait for the job with the given number to finish (and drop it).
+ *    Returns 0 if there is no such job.
+ ***/
+int waitJob(int id)
+{
+    int i;
+    for (i = 0; i < jobCount; i++)
+    {
+        if (jobs[i]->id == id)
+        {
+            reap(jobs[i], 1);
+            removeJob(i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/***
+ * waitJobs:
+ *    Wait for every job to finish (and drop them all).
+ ***/
+void waitJobs()
+{
+    while (jobCount > 0)
+    {
+        reap(jobs[0], 1);
+        removeJob(0);
+    }
+}
@@ -0,0 +1,42 @@
+/*******
+ * Dillon Welch
+ *
+ * Jobs:
+ *    The table of background jobs (statements ended with '&').
+ *
+ *    A job is every process started for the statement.  They are reaped
+ *    without blocking: the SIGCHLD handler only sets a flag, and the next
+ *    time the shell is about to run a statement (or JOBS/WAIT) each running
+ *    job's processes are checked with waitpid(WNOHANG).  Only the pids of
+ *    jobs are ever waited for here, so foreground statements still reap
+ *    their own children themselves.
+ *
+ *    JOBS lists the jobs (a finished job is listed once, then dropped).
+ *    Only the last MAX_DONE_JOBS finished jobs are kept for it.
+ *    WAIT waits for all of them, or for one: WAIT 2 or WAIT %2.
+ *******/
+
+#ifndef __JOBS_H
+#define __JOBS_H
+
+#include "command.h"
+#include <stdio.h>
+
+typedef struct job
+{
+    int id;            // Job number (as in [1])
+    int* pids;         // The processes of the job (0 for builtins) (REFERENCE is OWNED)
+    int* statuses;     // Wait status of each process, once it is done (REFERENCE is OWNED)
+    int count;         // Number of processes
+    int running;       // Number of processes not yet reaped
+    char* text;        // The statement (for listing) (REFERENCE is OWNED)
+} Job;
+
+void initJobs();
+Job* addJob(Statement* stmt, int* pids, int count);  // REFERENCE returned is BORROWED
+void reapJobs();
+void printJobs(FILE* stream);
+int waitJob(int id);
+void waitJobs();
+
+#endif
@@ -0,0 +1,193 @@
+/*******
+ * Dillon Welch
+ *
+ * Line Reader:
+ *    See lineReader.h for details.
+ *******/
+
+#include "lineReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define INITIAL_SIZE (64 * 1024)
+#define RELEASE_SIZE (8 * 1024 * 1024)   // Mapped pages are dropped this many bytes at a time
+
+/***
+ * initLineReader:
+ *    Start reading fd (nothing is read until the first readLine).
+ ***/
+void initLineReader(LineReader* reader, int fd)
+{
+    reader->fd = fd;
+    reader->size = INITIAL_SIZE;
+    reader->buf = malloc(reader->size + 1);
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = 0;
+    reader->heldAt = 0;
+    reader->held = '\0';
+    reader->mapped = 0;
+    reader->released = 0;
+}
+
+/***
+ * mapLineReader:
+ *    Start reading fd by mapping it (see lineReader.h).
+ *    Returns 0 (and leaves reader alone) if fd is not a regular file or can
+ *    not be mapped - the caller should use initLineReader instead.
+ ***/
+int mapLineReader(LineReader* reader, int fd)
+{
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        return 0;
+    }
+
+    // Reserve room for the file and (at least) one more byte, for the last
+    // line's '\0' - then map the file over the front of it.
+    size_t size = info.st_size;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t length = (size + page) & ~(page - 1);
+    char* area = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED)
+    {
+        return 0;
+    }
+    if (mmap(area, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(area, length);
+        return 0;
+    }
+    madvise(area, size, MADV_SEQUENTIAL);
+
+    reader->fd = fd;
+    reader->buf = area;
+    reader->size = size;
+    reader->start = 0;
+    reader->end = size;
+    reader->eof = 1;          // All of it is already "read"
+    reader->heldAt = 0;
+    reader->held = '\0';
+    reader->mapped = length;
+    reader->released = 0;
+    return 1;
+}
+
+/***
+ * freeLineReader:
+ *    Frees (or unmaps) the buffer (the stream itself is not closed).
+ ***/
+void freeLineReader(LineReader* reader)
+{
+    if (reader->mapped > 0) munmap(reader->buf, reader->mapped);
+    else free(reader->buf);
+    reader->buf = NULL;
+}
+
+/***
+ * release:
+ *    Drops the (copied) pages of a mapped script that have been used up.
+ ***/
+static void release(LineReader* reader)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t upTo = reader->start & ~(page - 1);
+    if (upTo - reader->released >= RELEASE_SIZE)
+    {
+        madvise(reader->buf + reader->released, upTo - reader->released, MADV_DONTNEED);
+        reader->released = upTo;
+    }
+}
+
+/***
+ * fill:
+ *    Reads more of the stream onto the end of the buffer, first moving what
+ *    is left to the front (and growing the buffer if it is all one line).
+ *    Returns 0 at the end of the stream.
+ ***/
+static int fill(LineReader* reader)
+{
+    if (reader->start > 0)
+    {
+        memmove(reader->buf, reader->buf + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+    if (reader->end == reader->size)
+    {
+        // One line fills the buffer
+        char* bigger = realloc(reader->buf, reader->size * 2 + 1);
+        if (bigger == NULL) return 0;
+        reader->buf = bigger;
+        reader->size *= 2;
+    }
+
+    ssize_t n;
+    do
+    {
+        n = read(reader->fd, reader->buf + reader->end, reader->size - reader->end);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0)
+    {
+        reader->eof = 1;
+        return 0;
+    }
+    reader->end += n;
+    return 1;
+}
+
+/***
+ * readLine:
+ *    See lineReader.h
+ ***/
+char* readLine(LineReader* reader, size_t* length)
+{
+    if (reader->heldAt > 0)
+    {
+        // Put back the byte the last line's '\0' went over
+        reader->buf[reader->heldAt] = reader->held;
+        reader->heldAt = 0;
+    }
+    if (reader->mapped > 0) release(reader);
+
+    size_t scanned = 0;   // Characters of the line known to have no '\n'
+    char* newline;
+    while ((newline = memchr(reader->buf + reader->start + scanned, '\n',
+                             reader->end - reader->start - scanned)) == NULL)
+    {
+        scanned = reader->end - reader->start;
+        if (reader->eof || !fill(reader)) break;
+    }
+
+    size_t lineEnd;
+    if (newline != NULL)
+    {
+        lineEnd = newline + 1 - reader->buf;
+    }
+    else if (reader->start < reader->end)
+    {
+        lineEnd = reader->end;   // Last line (without a '\n')
+    }
+    else
+    {
+        return NULL;
+    }
+
+    char* line = reader->buf + reader->start;
+    if (lineEnd < reader->end)
+    {
+        reader->heldAt = lineEnd;
+        reader->held = reader->buf[lineEnd];
+    }
+    reader->buf[lineEnd] = '\0';   // (buf always has room for one more)
+
+    if (length != NULL) *length = lineEnd - reader->start;
+    reader->start = lineEnd;
+    return line;
+}
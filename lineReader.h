@@ -0,0 +1,56 @@
+/*******
+ * Dillon Welch
+ *
+ * Line Reader:
+ *    Reads a stream one line at a time, with no limit on the line length.
+ *
+ *    Input is read (with read(2)) in large blocks into one buffer, and each
+ *    line is handed out right where it sits in the buffer (null-terminated,
+ *    with its '\n' if it had one).  The buffer only grows when a single line
+ *    does not fit in it, and is then kept at that size - so reading a script
+ *    does no allocation per line.  (On a terminal read returns a line at a
+ *    time anyway.)
+ *
+ *    Mapped scripts:
+ *       A regular file can instead be memory mapped (mapLineReader), so lines
+ *       are used right out of the page cache with no read copies at all.
+ *       The mapping is private (the tokenizer writes into the line; only the
+ *       pages written to are copied), the kernel is told it will be read
+ *       sequentially, and the copies of pages already read are dropped as the
+ *       script goes on.  Pipes, terminals and anything else that can not be
+ *       mapped are streamed as above.
+ *******/
+
+#ifndef __LINE_READER_H
+#define __LINE_READER_H
+
+#include <stddef.h>
+
+typedef struct
+{
+    int fd;          // The stream being read (REFERENCE is BORROWED)
+    char* buf;       // The buffered input (REFERENCE is OWNED)
+    size_t size;     // Bytes buf has room for (not counting a '\0')
+    size_t start;    // Offset of the first byte not yet handed out
+    size_t end;      // Offset just past the last byte read
+    int eof;         // Set once read returns 0 (or fails)
+    size_t heldAt;   // Offset of the byte replaced by the last line's '\0'
+    char held;       // The byte replaced (put back on the next readLine)
+    size_t mapped;   // Bytes mapped at buf (0 if buf is malloc'd)
+    size_t released; // Offset up to which mapped pages have been dropped
+} LineReader;
+
+void initLineReader(LineReader* reader, int fd);
+int mapLineReader(LineReader* reader, int fd);
+void freeLineReader(LineReader* reader);
+
+/***
+ * readLine:
+ *    Returns the next line (NULL at the end of the stream).
+ *    length (if not NULL) is set to the number of characters in it.
+ *    REFERENCE returned is BORROWED (valid until the next readLine) - the
+ *    caller may alter the line in place.
+ ***/
+char* readLine(LineReader* reader, size_t* length);
+
+#endif
@@ -0,0 +1,453 @@
+/*******
+ * Dillon Welch
+ *
+ * Parallel:
+ *    See parallel.h for details.
+ *******/
+
+#define _GNU_SOURCE
+#include "parallel.h"
+#include "global.h"
+#include "arena.h"
+#include "builtins.h"
+#include "expand.h"
+#include "lineReader.h"
+#include "tokenizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define ITEM_VAR "ITEM"
+#define ITEM_REFERENCE "$ITEM$"
+#define COPY_BLOCK (64 * 1024)
+
+/***
+ * One item, and the command run for it.
+ ***/
+typedef struct
+{
+    char* item;      // REFERENCE is BORROWED (statement arena)
+    int pid;         // The command (-1 if it could not be started, 0 if a builtin)
+    int pidfd;       // Becomes readable when the command exits (-1 if none)
+    int out;         // The temporary file its output goes to (-1 if none)
+    char* outPath;   // REFERENCE is BORROWED (statement arena)
+    int status;      // Wait status (once done)
+    int done;
+} ParallelJob;
+
+/***
+ * Output piped into a later command, held back (in a file) until the rest
+ * of the statement is started - see finishParallel.
+ ***/
+static struct
+{
+    int pending;
+    int spool;         // All the output, in item order
+    char* spoolPath;   // REFERENCE is BORROWED (statement arena)
+    int out;           // (Its own copy of the pipe)
+    int status;        // PARALLEL's wait status
+} held;
+
+/***
+ * addItem:
+ *    Appends item to the (arena) array of items, growing it as needed.
+ ***/
+static void addItem(char*** items, int* count, int* capacity, char* item)
+{
+    if (*count == *capacity)
+    {
+        int newCapacity = *capacity == 0 ? 64 : *capacity * 2;
+        *items = arenaRealloc(&statementArena, *items, *capacity * sizeof(char*), newCapacity * sizeof(char*));
+        *capacity = newCapacity;
+    }
+    (*items)[(*count)++] = item;
+}
+
+/***
+ * readItems:
+ *    The items: the words of the variable name, or (if name is NULL) the
+ *    non-blank lines of standard input.
+ *    REFERENCE returned is BORROWED (statement arena)
+ ***/
+static char** readItems(char* name, int* count)
+{
+    char** items = NULL;
+    int capacity = 0;
+    *count = 0;
+
+    if (name != NULL)
+    {
+        VarEntry* var = findInSet(varList, name);
+        if (var == NULL) return NULL;
+
+        char* words = arenaStrndup(&statementArena, var->value, strlen(var->value));
+        char* save;
+        char* word;
+        for (word = strtok_r(words, " \t\n", &save); word != NULL; word = strtok_r(NULL, " \t\n", &save))
+        {
+            addItem(&items, count, &capacity, word);
+        }
+        return items;
+    }
+
+    fflush(stdout);
+    LineReader reader;
+    initLineReader(&reader, 0);
+    char* line;
+    size_t length;
+    while ((line = readLine(&reader, &length)) != NULL)
+    {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) length--;
+        if (strspn(line, " \t") >= length) continue;   // Blank
+        addItem(&items, count, &capacity, arenaStrndup(&statementArena, line, length));
+    }
+    freeLineReader(&reader);
+    return items;
+}
+
+/***
+ * expandArg:
+ *    The argument with its variables substituted (PARALLEL's arguments are
+ *    left as they are when the line is read - see processLine).
+ *    REFERENCE returned is BORROWED (the line, or the statement arena)
+ ***/
+static char* expandArg(ArgList* arg)
+{
+    if (arg->tokenType == SINGLE_QUOTE || strchr(arg->arg, '$') == NULL) return arg->arg;
+    int changeFlag;
+    return preprocess(varList, arg->arg, &changeFlag, &statementArena);
+}
+
+/***
+ * mentionsItem:
+ *    Whether any argument of the template refers to $ITEM$.
+ ***/
+static int mentionsItem(ArgList* args)
+{
+    ArgList* curr;
+    for (curr = args; curr != NULL; curr = curr->next)
+    {
+        if (curr->tokenType != SINGLE_QUOTE && strstr(curr->arg, ITEM_REFERENCE) != NULL) return 1;
+    }
+    return 0;
+}
+
+/***
+ * tempFile:
+ *    Makes a new (empty) temporary file, close-on-exec.
+ *    path is set to its name (REFERENCE is BORROWED - statement arena)
+ *    Returns its descriptor, or -1 (after reporting why).
+ ***/
+static int tempFile(char** path)
+{
+    const char* tmp = getenv("TMPDIR");
+    size_t length = strlen(tmp == NULL ? "/tmp" : tmp) + sizeof("/techShellXXXXXX");
+    *path = arenaAlloc(&statementArena, length);
+    snprintf(*path, length, "%s/techShellXXXXXX", tmp == NULL ? "/tmp" : tmp);
+    int file = mkostemp(*path, O_CLOEXEC);
+    if (file == -1) fprintf(stderr, "PARALLEL: %s: %s\n", *path, strerror(errno));
+    return file;
+}
+
+/***
+ * launch:
+ *    Starts the command for the job: ITEM is set to its item, and the
+ *    template (args, from the command on) is expanded for it.
+ *    Its input is devNull, its output a new temporary file (job->out).
+ ***/
+static void launch(ParallelJob* job, ArgList* args, int appendItem, int devNull)
+{
+    addSpecialToSet(varList, ITEM_VAR, job->item);
+
+    Command* cmd = newCommand(expandArg(args));
+    ArgList* curr;
+    for (curr = args->next; curr != NULL; curr = curr->next)
+    {
+        addArg(cmd, expandArg(curr), curr->tokenType);
+    }
+    if (appendItem) addArg(cmd, job->item, BASIC);
+
+    // Its output waits in a file of its own
+    job->out = tempFile(&job->outPath);
+    if (job->out == -1)
+    {
+        job->pid = -1;
+        job->pidfd = -1;
+        return;
+    }
+    cmd->inFd = devNull;
+    cmd->outFd = job->out;
+
+    job->pid = processCommand(cmd, 0);
+    job->pidfd = job->pid > 0 ? syscall(SYS_pidfd_open, job->pid, 0) : -1;
+}
+
+/***
+ * finish:
+ *    Notes the job done with the given wait status.
+ ***/
+static void finish(ParallelJob* job, int status)
+{
+    job->status = status;
+    job->done = 1;
+    if (job->pidfd != -1) close(job->pidfd);
+    job->pidfd = -1;
+}
+
+/***
+ * waitForOne:
+ *    Waits until at least one of the running jobs is done (reaping them).
+ *    With pidfds this is whichever exits first; without, the first one.
+ ***/
+static void waitForOne(ParallelJob** running, int* count, struct pollfd* fds)
+{
+    int i;
+    int ready = 0;
+    for (i = 0; i < *count; i++)
+    {
+        if (running[i]->pidfd == -1) break;
+        fds[i].fd = running[i]->pidfd;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+    if (i == *count)
+    {
+        while ((ready = poll(fds, *count, -1)) == -1 && errno == EINTR);
+    }
+
+    for (i = 0; i < *count; )
+    {
+        // No pidfd (or poll failed) - just wait for it
+        if (ready > 0 && !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            i++;
+            continue;
+        }
+
+        int status;
+        if (waitpid(running[i]->pid, &status, 0) == -1) status = 1 << 8;
+        finish(running[i], status);
+        running[i] = running[*count - 1];
+        fds[i] = fds[*count - 1];
+        (*count)--;
+        if (ready <= 0) return;
+    }
+}
+
+/***
+ * restoreItem:
+ *    Puts ITEM back the way it was before PARALLEL set it: value (a
+ *    special variable if special is set), or unset if value is NULL.
+ ***/
+static void restoreItem(char* value, int special)
+{
+    if (value == NULL)
+    {
+        removeFromSet(varList, ITEM_VAR);
+        return;
+    }
+    addToSet(varList, ITEM_VAR, value, -1);
+    findInSet(varList, ITEM_VAR)->special = special;
+}
+
+/***
+ * copyFile:
+ *    Copies the whole file (from its start) to the descriptor to.
+ ***/
+static void copyFile(int file, int to)
+{
+    char buffer[COPY_BLOCK];
+    ssize_t got;
+    lseek(file, 0, SEEK_SET);
+    while ((got = read(file, buffer, sizeof(buffer))) > 0 || (got == -1 && errno == EINTR))
+    {
+        ssize_t written = 0;
+        while (got > 0 && written < got)
+        {
+            ssize_t put = write(to, buffer + written, got - written);
+            if (put == -1 && errno == EINTR) continue;
+            if (put == -1) break;
+            written += put;
+        }
+    }
+}
+
+/***
+ * copyOutput:
+ *    Copies the job's output to the descriptor to, and removes its file.
+ ***/
+static void copyOutput(ParallelJob* job, int to)
+{
+    if (job->out == -1) return;
+
+    copyFile(job->out, to);
+    close(job->out);
+    unlink(job->outPath);
+    job->out = -1;
+}
+
+/***
+ * processParallel:
+ *    PARALLEL [-j N] [-v var] command args...
+ *    Runs the command once for each item, at most N at a time (see parallel.h).
+ ***/
+void processParallel(Command* cmd)
+{
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    char* var = NULL;
+    ArgList* curr = cmd->head;
+
+    // Options
+    for ( ; curr != NULL && curr->tokenType == BASIC && curr->arg[0] == '-'; curr = curr->next)
+    {
+        if (strncmp(curr->arg, "-j", 2) == 0)
+        {
+            char* count = curr->arg[2] != '\0' ? curr->arg + 2 : (curr->next != NULL ? expandArg(curr = curr->next) : "");
+            workers = atol(count);
+            if (workers <= 0)
+            {
+                fprintf(stderr, "PARALLEL: -j needs a number of jobs\n");
+                builtinStatus = 2 << 8;
+                return;
+            }
+        }
+        else if (strcmp(curr->arg, "-v") == 0 && curr->next != NULL)
+        {
+            curr = curr->next;
+            var = expandArg(curr);
+        }
+        else
+        {
+            fprintf(stderr, "PARALLEL: Unknown option %s\n", curr->arg);
+            builtinStatus = 2 << 8;
+            return;
+        }
+    }
+    if (curr == NULL)
+    {
+        fprintf(stderr, "PARALLEL: Missing command\n");
+        builtinStatus = 2 << 8;
+        return;
+    }
+    if (workers < 1) workers = 1;
+
+    // Output into a pipe is held back until the rest of the statement is
+    //    started (see finishParallel) - which a builtin further down is not
+    int piped = (cmd->output == PIPE_OUT && cmd->outFd == -1);
+    Command* reader;
+    for (reader = piped ? cmd->reader : NULL; reader != NULL; reader = reader->reader)
+    {
+        if (isBuiltin(reader->command))
+        {
+            fprintf(stderr, "PARALLEL: Can not pipe into the builtin %s\n", reader->command);
+            builtinStatus = 2 << 8;
+            return;
+        }
+    }
+
+    int count;
+    char** items = readItems(var, &count);
+    if (count == 0) return;
+    if (workers > count) workers = count;
+
+    int to = 1;   // Where the output goes
+    char* spoolPath = NULL;
+    if (piped && (to = tempFile(&spoolPath)) == -1)
+    {
+        builtinStatus = 1 << 8;
+        return;
+    }
+
+    ParallelJob* jobs = arenaAlloc(&statementArena, count * sizeof(ParallelJob));
+    ParallelJob** running = arenaAlloc(&statementArena, workers * sizeof(ParallelJob*));
+    struct pollfd* fds = arenaAlloc(&statementArena, workers * sizeof(struct pollfd));
+    int appendItem = !mentionsItem(curr);
+    int devNull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    int runningCount = 0;
+    int next = 0;      // Next item to start
+    int printed = 0;   // Next item to print the output of
+    int failed = 0;
+
+    // ITEM is set for each job - what it was before is put back at the end
+    VarEntry* item = findInSet(varList, ITEM_VAR);
+    char* savedItem = item == NULL ? NULL : arenaStrndup(&statementArena, item->value, strlen(item->value));
+    int savedSpecial = item != NULL && item->special;
+
+    fflush(stdout);
+    while (printed < count)
+    {
+        while (runningCount < workers && next < count)
+        {
+            ParallelJob* job = &jobs[next++];
+            job->item = items[next - 1];
+            job->done = 0;
+            launch(job, curr, appendItem, devNull);
+            if (job->pid > 0) running[runningCount++] = job;
+            else finish(job, job->pid == 0 ? builtinStatus : 1 << 8);
+        }
+
+        // Output in item order, as soon as it can be
+        while (printed < count && printed < next && jobs[printed].done)
+        {
+            if (jobs[printed].status != 0) failed++;
+            copyOutput(&jobs[printed++], to);
+        }
+
+        if (runningCount > 0) waitForOne(running, &runningCount, fds);
+    }
+
+    close(devNull);
+    restoreItem(savedItem, savedSpecial);
+    builtinStatus = (failed > 255 ? 255 : failed) << 8;
+
+    if (piped)
+    {
+        held.pending = 1;
+        held.spool = to;
+        held.spoolPath = spoolPath;
+        held.out = fcntl(1, F_DUPFD_CLOEXEC, 3);
+        held.status = builtinStatus;
+    }
+}
+
+/***
+ * parallelPending:
+ *    Whether PARALLEL output is held back (not yet copied into its pipe).
+ ***/
+int parallelPending()
+{
+    return held.pending;
+}
+
+/***
+ * finishParallel:
+ *    Copies the output held back by processParallel into its pipe, now that
+ *    the commands reading it are started.  A reader that went away is
+ *    reported as EPIPE (SIGPIPE would kill the shell itself).
+ *    Returns PARALLEL's wait status.
+ ***/
+int finishParallel()
+{
+    if (!held.pending) return 0;
+    held.pending = 0;
+
+    struct sigaction ignore;
+    struct sigaction saved;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &saved);
+    copyFile(held.spool, held.out);
+    sigaction(SIGPIPE, &saved, NULL);
+
+    close(held.spool);
+    unlink(held.spoolPath);
+    close(held.out);
+    return held.status;
+}
@@ -0,0 +1,45 @@
+/*******
+ * Dillon Welch
+ *
+ * Parallel:
+ *    The PARALLEL builtin - runs one command over a list of items, several
+ *    at a time.
+ *
+ *       PARALLEL [-j N] [-v var] command args...
+ *
+ *    The items are the lines of standard input (blank ones skipped), or the
+ *    words of the variable var with -v.  PARALLEL's arguments are not
+ *    expanded when the line is read: for each item the ITEM variable is set
+ *    to it, and then the command and its arguments are expanded, so $ITEM$
+ *    is the item wherever it is (n=$ITEM$, "item $ITEM$", ...).  In single
+ *    quotes it is left as it is, like any $var$.  If no argument mentions
+ *    $ITEM$, the item is added as the last argument.
+ *
+ *    At most N commands (the number of CPUs by default) run at once.  They
+ *    are launched like any other command (see processCommand), with input
+ *    from /dev/null and output to a temporary file of their own.  Each
+ *    one's output is copied to standard output once it and all the items
+ *    before it are done, so the output is in item order and never mixed
+ *    together.  (Standard error is not buffered.)  Output piped into another
+ *    command is held back (in a file) until the rest of the statement is
+ *    started, then copied into the pipe (see processStatement) - written
+ *    right away, it could fill the pipe before anything reads it, and the
+ *    shell would wait forever.  So it can not pipe into a builtin (the
+ *    shell runs those itself, before the output is let out).
+ *
+ *    The exit code is the number of commands that failed (at most 255).
+ *    ITEM is only set while the commands run (as a special variable - it is
+ *    not listed by LIST).  Once they are done, a variable ITEM the script
+ *    had set is put back as it was (or it is unset again if it had none).
+ *******/
+
+#ifndef __PARALLEL_H
+#define __PARALLEL_H
+
+#include "command.h"
+
+void processParallel(Command* cmd);
+int parallelPending();
+int finishParallel();
+
+#endif
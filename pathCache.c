@@ -0,0 +1,270 @@
+/*******
+ * Dillon Welch
+ *
+ * Path Cache:
+ *    See pathCache.h for details.
+ *******/
+
+#include "pathCache.h"
+#include "varSet.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define INITIAL_SIZE 64              // Must be a power of 2.
+#define DEFAULT_PATH "/bin:/usr/bin" // If PATH is not set
+
+/***
+ * A cached command (name is NULL if the bucket is empty).
+ ***/
+typedef struct
+{
+    char* name;          // REFERENCE is OWNED
+    char* path;          // Full path of the command (REFERENCE is OWNED)
+    unsigned int hash;   // Hash of name
+    int hits;            // Times it was looked up (after the first)
+} PathEntry;
+
+static PathEntry* table = NULL;
+static unsigned int tableMask = 0;
+static int tableCount = 0;
+
+static char* pathValue = NULL;          // The PATH the table is for (OWNED)
+static char* dirBuffer = NULL;          // The directories of PATH, '\0' separated (OWNED)
+static char** dirs = NULL;              // Each directory (BORROWED - in dirBuffer)
+static struct timespec* dirTimes = NULL; // Modification time of each directory
+static int dirCount = 0;
+static time_t lastCheck = 0;            // When the directories were last checked (seconds)
+static char* uncached = NULL;           // A path found through a relative directory (OWNED)
+
+/***
+ * clearPathCache:
+ *    Forgets every cached command.
+ ***/
+void clearPathCache()
+{
+    unsigned int i;
+    for (i = 0; table != NULL && i <= tableMask; i++)
+    {
+        free(table[i].name);
+        free(table[i].path);
+    }
+    free(table);
+    table = NULL;
+    tableMask = 0;
+    tableCount = 0;
+}
+
+/***
+ * dirTime:
+ *    The modification time of directory i (zero if it can not be found).
+ ***/
+static struct timespec dirTime(int i)
+{
+    struct stat info;
+    if (stat(dirs[i], &info) != 0)
+    {
+        struct timespec none = { 0, 0 };
+        return none;
+    }
+    return info.st_mtim;
+}
+
+/***
+ * setPath:
+ *    Start over with a new PATH (split into its directories).
+ ***/
+static void setPath(const char* path)
+{
+    clearPathCache();
+    free(pathValue);
+    free(dirBuffer);
+    free(dirs);
+    free(dirTimes);
+
+    pathValue = strdup(path);
+    dirBuffer = strdup(path);
+    dirCount = 1;
+    char* p;
+    for (p = dirBuffer; *p != '\0'; p++)
+    {
+        if (*p == ':') dirCount++;
+    }
+    dirs = malloc(dirCount * sizeof(char*));
+    dirTimes = malloc(dirCount * sizeof(struct timespec));
+
+    int i = 0;
+    char* start = dirBuffer;
+    for (p = dirBuffer; ; p++)
+    {
+        if (*p == ':' || *p == '\0')
+        {
+            int last = (*p == '\0');
+            *p = '\0';
+            dirs[i] = (*start == '\0') ? "." : start;  // An empty entry is the current directory
+            dirTimes[i] = dirTime(i);
+            i++;
+            start = p + 1;
+            if (last) break;
+        }
+    }
+}
+
+/***
+ * checkPath:
+ *    Empties the table if PATH, or any directory in it, has changed.
+ *    (The directories are only looked at every PATH_CHECK_INTERVAL seconds.)
+ ***/
+static void checkPath()
+{
+    const char* path = getenv("PATH");
+    if (path == NULL) path = DEFAULT_PATH;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);   // (No syscall)
+
+    if (pathValue == NULL || strcmp(path, pathValue) != 0)
+    {
+        setPath(path);
+        lastCheck = now.tv_sec;
+        return;
+    }
+    if (now.tv_sec - lastCheck < PATH_CHECK_INTERVAL)
+    {
+        return;
+    }
+    lastCheck = now.tv_sec;
+
+    int i;
+    for (i = 0; i < dirCount; i++)
+    {
+        struct timespec time = dirTime(i);
+        if (time.tv_sec != dirTimes[i].tv_sec || time.tv_nsec != dirTimes[i].tv_nsec)
+        {
+            // Something was added/removed - everything after it could be shadowed now
+            dirTimes[i] = time;
+            clearPathCache();
+        }
+    }
+}
+
+/***
+ * search:
+ *    Finds name in the PATH directories (the first executable file).
+ *    relative is set if it was found through a relative directory.
+ *    REFERENCE returned is GIVEN (NULL if not found)
+ ***/
+static char* search(const char* name, int* relative)
+{
+    char full[PATH_MAX];
+    int i;
+    for (i = 0; i < dirCount; i++)
+    {
+        if (snprintf(full, sizeof(full), "%s/%s", dirs[i], name) >= (int) sizeof(full)) continue;
+
+        struct stat info;
+        if (access(full, X_OK) == 0 && stat(full, &info) == 0 && S_ISREG(info.st_mode))
+        {
+            *relative = (dirs[i][0] != '/');
+            return strdup(full);
+        }
+    }
+    return NULL;
+}
+
+/***
+ * insert:
+ *    Adds the command to the table (growing it to stay at most half full).
+ ***/
+static void insert(char* name, char* path, unsigned int hash)
+{
+    unsigned int i;
+    if (table == NULL)
+    {
+        tableMask = INITIAL_SIZE - 1;
+        table = calloc(INITIAL_SIZE, sizeof(PathEntry));
+    }
+    else if ((tableCount + 1) * 2 > tableMask + 1)
+    {
+        unsigned int oldMask = tableMask;
+        PathEntry* old = table;
+        tableMask = tableMask * 2 + 1;
+        table = calloc(tableMask + 1, sizeof(PathEntry));
+        for (i = 0; i <= oldMask; i++)
+        {
+            if (old[i].name == NULL) continue;
+            unsigned int j = old[i].hash & tableMask;
+            while (table[j].name != NULL) j = (j + 1) & tableMask;
+            table[j] = old[i];
+        }
+        free(old);
+    }
+
+    i = hash & tableMask;
+    while (table[i].name != NULL) i = (i + 1) & tableMask;
+    table[i].name = name;
+    table[i].path = path;
+    table[i].hash = hash;
+    table[i].hits = 0;
+    tableCount++;
+}
+
+/***
+ * commandPath:
+ *    Returns the full path of the command name (as exec would find it on
+ *    PATH), or NULL if there is no such command.
+ *    REFERENCE returned is BORROWED (until the cache is next used)
+ ***/
+const char* commandPath(const char* name)
+{
+    if (strchr(name, '/') != NULL)
+    {
+        return name;  // A path already
+    }
+    checkPath();
+
+    unsigned int hash = hashString(name, strlen(name));
+    unsigned int i;
+    for (i = hash & tableMask; table != NULL && table[i].name != NULL; i = (i + 1) & tableMask)
+    {
+        if (table[i].hash == hash && strcmp(table[i].name, name) == 0)
+        {
+            table[i].hits++;
+            return table[i].path;
+        }
+    }
+
+    // First time - go look for it
+    int relative;
+    char* path = search(name, &relative);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+    if (relative)
+    {
+        // Depends on the current directory - not cached
+        free(uncached);
+        uncached = path;
+        return path;
+    }
+    insert(strdup(name), path, hash);
+    return path;
+}
+
+/***
+ * printPathCache:
+ *    Prints each cached command: its name, path and number of hits.
+ ***/
+void printPathCache(FILE* stream)
+{
+    unsigned int i;
+    for (i = 0; table != NULL && i <= tableMask; i++)
+    {
+        if (table[i].name == NULL) continue;
+        fprintf(stream, "%s: %s (%d hits)\n", table[i].name, table[i].path, table[i].hits);
+    }
+}
@@ -0,0 +1,33 @@
+/*******
+ * Dillon Welch
+ *
+ * Path Cache:
+ *    Where each command is found on the PATH, so it can be exec'd directly
+ *    (execve/posix_spawn on the full path) instead of trying every PATH
+ *    directory in turn for every command (as execvp does).
+ *
+ *    A command is looked up the first time it is used and remembered in a
+ *    hash table (by name).  The table is emptied when PATH changes, or when
+ *    the modification time of any PATH directory changes (a command was
+ *    added, removed or renamed).  The directories are checked at most once
+ *    every PATH_CHECK_INTERVAL seconds, so most commands cost no syscalls
+ *    at all before the exec itself.
+ *
+ *    Names with a '/' in them are used as they are (never cached), as are
+ *    commands found through a relative PATH entry (like "." or "").
+ *
+ *    The HASH builtin lists, clears and pre-warms the table.
+ *******/
+
+#ifndef __PATH_CACHE_H
+#define __PATH_CACHE_H
+
+#include <stdio.h>
+
+#define PATH_CHECK_INTERVAL 1
+
+const char* commandPath(const char* name);  // REFERENCE returned is BORROWED (NULL if not found)
+void clearPathCache();
+void printPathCache(FILE* stream);
+
+#endif
@@ -0,0 +1,100 @@
+/*******
+ * Dillon Welch
+ *
+ * Stats:
+ *    See stats.h for details.
+ *******/
+
+#include "stats.h"
+#include <string.h>
+#include <sys/resource.h>
+
+Stats stats;
+
+/***
+ * recordLatency:
+ *    Counts a launched command that ran for the given seconds.
+ ***/
+void recordLatency(double seconds)
+{
+    unsigned long micros = seconds > 0 ? (unsigned long) (seconds * 1e6) : 0;
+    int bucket = micros < 2 ? 0 : 63 - __builtin_clzl(micros);
+    if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+    stats.latency[bucket]++;
+}
+
+/***
+ * formatMicros:
+ *    The microseconds in short form (us, ms or s).  Returns text.
+ ***/
+static char* formatMicros(double micros, char* text, size_t size)
+{
+    if (micros < 1000) snprintf(text, size, "%.0fus", micros);
+    else if (micros < 1e6) snprintf(text, size, "%.3gms", micros / 1e3);
+    else snprintf(text, size, "%.3gs", micros / 1e6);
+    return text;
+}
+
+/***
+ * percentile:
+ *    The bucket holding the given fraction of the commands (of count).
+ ***/
+static int percentile(unsigned long count, double fraction)
+{
+    unsigned long seen = 0;
+    int i;
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += stats.latency[i];
+        if (seen >= count * fraction) break;
+    }
+    return i < LATENCY_BUCKETS ? i : LATENCY_BUCKETS - 1;
+}
+
+/***
+ * printStats:
+ *    Prints the counters (with the arena's), and the histogram of command times.
+ ***/
+void printStats(FILE* stream, Arena* arena)
+{
+    fprintf(stream, ">> Lines: %lu lines, %lu statements, %lu tokens\n",
+            stats.lines, stats.statements, stats.tokens);
+    fprintf(stream, ">> Expansion: %lu tokens, %lu values expanded, %lu from the memo\n",
+            stats.expansions, stats.substitutions, stats.memoHits);
+    fprintf(stream, ">> Variables: %lu lookups, %.2f probes each, %lu at most\n",
+            stats.lookups, stats.lookups ? (double) stats.probes / stats.lookups : 0.0, stats.longestProbe);
+    fprintf(stream, ">> Commands: %lu builtins, %lu in the shell, %lu spawned, %lu forked, %lu not started, %lu pipes\n",
+            stats.builtins, stats.fastPaths, stats.spawns, stats.forks, stats.failures, stats.pipes);
+    fprintf(stream, ">> Arena: %lu statements, %lu allocations (%lu bytes), %lu mallocs\n",
+            arena->resets, arena->allocs, arena->bytes, arena->mallocs);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stream, ">> Memory: %ldK peak resident (the shell itself)\n", usage.ru_maxrss);
+
+    unsigned long count = 0;
+    int i;
+    for (i = 0; i < LATENCY_BUCKETS; i++) count += stats.latency[i];
+    if (count == 0) return;
+
+    char low[16];
+    char high[16];
+    fprintf(stream, ">> Command times (launch to reap): %lu commands, p50 < %s, p99 < %s\n", count,
+            formatMicros(2.0 * (1ul << percentile(count, 0.5)), low, sizeof(low)),
+            formatMicros(2.0 * (1ul << percentile(count, 0.99)), high, sizeof(high)));
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        if (stats.latency[i] == 0) continue;
+        fprintf(stream, "   %8s - %-8s %10lu\n", i == 0 ? "0us" : formatMicros(1ul << i, low, sizeof(low)),
+                formatMicros(2.0 * (1ul << i), high, sizeof(high)), stats.latency[i]);
+    }
+}
+
+/***
+ * clearStats:
+ *    Starts all the counts (the arena's too) over from 0.
+ ***/
+void clearStats(Arena* arena)
+{
+    memset(&stats, 0, sizeof(stats));
+    arena->mallocs = arena->allocs = arena->bytes = arena->resets = 0;
+}
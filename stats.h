@@ -0,0 +1,56 @@
+/*******
+ * Dillon Welch
+ *
+ * Stats:
+ *    Counters for what the shell does the most, cheap enough to always be
+ *    on (each is an increment where it happens):
+ *       lines, statements and tokens parsed
+ *       tokens expanded, and the variable values expanded for them (or
+ *       taken from the memo - see expand.h)
+ *       variable table lookups and how many buckets they probed
+ *       builtins and fast path commands run, commands spawned or forked
+ *       (and ones that could not be started), pipes made
+ *       the statement arena's allocations (see arena.h), and the shell's
+ *       peak resident size
+ *    and a histogram of how long each launched command ran, from launch
+ *    until it was reaped (in buckets that double: under 2us, 2-4us, ...).
+ *
+ *    STATS prints them, STATS -r clears them.  With TECHSHELL_STATS set
+ *    they are printed on stderr at exit.
+ *******/
+
+#ifndef __STATS_H
+#define __STATS_H
+
+#include "arena.h"
+#include <stdio.h>
+
+#define LATENCY_BUCKETS 32
+
+typedef struct
+{
+    unsigned long lines;           // Lines processed
+    unsigned long statements;      // Statements run
+    unsigned long tokens;          // Tokens parsed
+    unsigned long expansions;      // Tokens expanded (with a $)
+    unsigned long substitutions;   // Variable values expanded for them
+    unsigned long memoHits;        // ... or taken from the memo instead
+    unsigned long lookups;         // Variable table lookups
+    unsigned long probes;          // Buckets looked at by them
+    unsigned long longestProbe;    // Most buckets looked at by one
+    unsigned long builtins;        // Builtins run
+    unsigned long fastPaths;       // Commands run by the shell (see fastPath.h)
+    unsigned long spawns;          // Commands launched with posix_spawn
+    unsigned long forks;           // ... or fork (and exec)
+    unsigned long failures;        // Commands that could not be started
+    unsigned long pipes;           // Pipes made
+    unsigned long latency[LATENCY_BUCKETS];  // Commands by microseconds run (bucket i: 2^i to 2^(i+1))
+} Stats;
+
+extern Stats stats;
+
+void recordLatency(double seconds);
+void printStats(FILE* stream, Arena* arena);
+void clearStats(Arena* arena);
+
+#endif
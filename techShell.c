@@ -15,6 +15,16 @@
  *     CD [directory]: changes the directory to "directory", changes to home directory
  *                     (or root if there is none) with no argument.
  *     PWD: Prints the working directory.
+ *     JOBS: lists the background jobs.
+ *     WAIT [job]: waits for the given background job (or all of them) to finish.
+ *     HASH [-r] [command...]: lists the cached command paths, clears them (-r),
+ *                     or looks up the given commands now (see pathCache.h).
+ *     PARALLEL [-j N] [-v var] command args...: runs the command for each line of
+ *                     input (or word of var), N at a time (see parallel.h).
+ *     STATS [-r]: prints the shell's counters and command times, or clears them (-r)
+ *                     (see stats.h).
+ *     TIME [-m] statement: runs the statement, then prints the time and resources
+ *                     each of its commands used (-m: for scripts - see timing.h).
  *
  *   It ignores COMMENTS
  *     A COMMENT is started by the token # and continues to end of the line.
@@ -23,16 +33,32 @@
  *     Each group of commands ends with either a new line or a semicolon.
  *     The exit status of a group of commands is exit status of the last
  *     command in the sequence.
+ *     echo, cat, true and false are usually run in the shell itself, without
+ *     launching anything (SET FASTPATH 0 turns that off - see fastPath.h).
+ *     SET PIPESIZE 1M sets the buffer size of the pipes between commands
+ *     (bytes, or K or M; the default is the kernel's, 64K).
+ *
+ *   A statement ended with '&' (instead of ';' or a new line) is run in the
+ *   background, as a job (see jobs.h).  JOBS lists them, WAIT [job] waits for them.
  *
  *   It supports input and output redirection.
  *     '<'  will redirect standard input from a file (the file must exist of course).
- *     '>'  will redirect standard output to a file (the file will be created if it does not exist).
+ *     '>'  will redirect standard output to a file (the file will be created if it does not exist,
+ *          and emptied first if it does).
+ *     '>>' will append standard output to a file (the file will be created if it does not exist).
  *     '>&' will redirect standard error to a file (the file will be created it if does not exist).
  *
  *   Variable substitution:
- *      Variables are repeatedly substituted using the following sequence:
+ *      Variables are recursively substituted using the following sequence:
  *        $var$  - which are not done in single quotes '$var$'
- *      ...
+ *      See expand.h for the details.
+ *
+ *   Environment:
+ *     TECHSHELL_MMAP=0        read a script file as a stream instead of mapping it
+ *                             (see lineReader.h).
+ *     TECHSHELL_STATS         print the shell's counters (as STATS does) at exit.
+ *     TECHSHELL_TRACE=file    write a Chrome trace of what the shell did to file
+ *                             (see trace.h).
  ********/
 
 #include <assert.h>
@@ -45,82 +71,50 @@
 #include "varSet.h"
 #include "command.h"
 #include "builtins.h"
+#include "expand.h"
+#include "lineReader.h"
+#include "jobs.h"
+#include "trace.h"
+#include "stats.h"
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
 
-#define MAX_LINE_LENGTH 500
-#define MAX_SUBSTITUTION_LEVEL 10
-
 // The set of variables in this shell.
 VarSet* varList = NULL;
 
+// Memory for the statement being processed (see arena.h).
+Arena statementArena;
+
+// The rest of the globals (see global.h).
+int comm[2];
+int status;
+int builtinStatus;
+int sFlag;
+char *dir;
+
 /***
- * preprocess:
- *   Takes a given token and does variable replacement (if needed)
- *   Returns a string representing the expanded string.
- *      Sets changeFlgag to 1 if any substitution was made and 0 otherwise
- *   REFERENCE returned is GIVEN
+ * statementError:
+ *    Reports a (syntax) error in the statement being parsed and drops it -
+ *    nothing in it has been run.
  ***/
-char* preprocess(char* token, int *changeFlag)
+static void statementError(const char* message)
 {
-    *changeFlag = 0;
-    // Find variable names that are separated by $...$
-    char *response = malloc((MAX_LINE_LENGTH+1)*sizeof(char));
-    char *responseEnd = response + MAX_LINE_LENGTH;
-    char *currResponse, *curr, *start;
-
-    start = NULL;
-
-    // Go through each character in the token
-    for (currResponse = response, curr = token; *curr != '\0'; curr++)
-    {
-        if (*curr == '$')         // Variable name delimiter
-        {
-            if (start == NULL)      //    Start of variable name
-            {
-                *changeFlag = 1;       // A substitution will have been made (or truncated!)
-                start = curr;
-            }
-            else
-            {
-                char temp = *curr;    //    Mark the end with a 0
-                *curr = '\0';
-                // Lookup the variable name in the varSet
-                VarSet* match = findInSet(varList, start+1);
-                *curr = temp;         //    Replace previous character back (so transparent - safer)
-                if (match != NULL)
-                {
-                    // No error if no match found - and copy value if there is.
-                    char* copy;
-                    for (copy = match->value; *copy != '\0' && currResponse < responseEnd;
-                            copy++, currResponse++)
-                    {
-                        *currResponse = *copy;
-                    }
-                }
-                start = NULL;         // Reset to next variable name
-            }
-        }
-        else
-        {
-            if (start == NULL)
-            {
-                if (currResponse < responseEnd)
-                {
-                    // If too long - it is just ignored - otherwise character is copied in.
-                    *currResponse = *curr;
-                    currResponse++;
-                }
-            }
-        }
-    }
-    *currResponse = '\0';   // Terminate our (expanded) string copy
-    return response;
+    fprintf(stderr, "%s\n", message);
+    resetArena(&statementArena);
 }
 
 /***
  * processLine:
  *    line: string to process (REFERENCE is BORROWED)
+ *          The line is tokenized in place, so it gets altered.  Tokens that
+ *          need no expansion are used right out of it (never copied).
+ *          Everything else a statement needs comes from the statement arena,
+ *          which is reset when the statement is done (or abandoned).
+ *
+ *    Each statement is parsed into a Statement (a pipeline of commands, each
+ *    with its redirects) and only run once it is complete, so an error in it
+ *    is reported before any of its commands are started.
  ***/
 void processLine(char* line)
 {
@@ -129,151 +123,130 @@ void processLine(char* line)
         CMD, PIPED_CMD, ARGS
     } processMode;
     processMode = CMD;
+    enum
+    {
+        NONE, IN_FILE, OUT_FILE, APPEND_FILE, ERR_FILE
+    } redirect;     // The redirect waiting for its file name (if any)
+    redirect = NONE;
+    Statement* stmt = newStatement();
     Command* cmd = NULL;
     int doneFlag = 0;
     char* expandedToken = NULL;
+    double parseStart = traceClock();  // (When tracing - see trace.h)
 
-    startToken(line);
+    Tokenizer tokenizer;
+    initTokenizer(&tokenizer, line);
     aToken answer;
 
-    answer = getNextToken();
+    stats.lines++;
+    answer = nextToken(&tokenizer);
     while (!doneFlag)
     {
+        stats.tokens++;
         switch (answer.type)
         {
         case ERROR:
             // Error (for some reason)
-            fprintf(stderr, "Error parsing line.\n");
-            if (cmd != NULL)
-            {
-                freeCommand(cmd);
-                cmd = NULL;
-            }
+            statementError("Error parsing line.");
             return;
 
         case BASIC:
         case DOUBLE_QUOTE:
         case SINGLE_QUOTE:
-            if (answer.type != SINGLE_QUOTE)
+            if (answer.type != SINGLE_QUOTE && memchr(answer.start, '$', answer.length) != NULL &&
+                !(processMode == ARGS && redirect == NONE && strcasecmp(cmd->command, "PARALLEL") == 0))
             {
-                int changeFlag = 1;
-                int count = 1;
-                expandedToken = preprocess(answer.start, &changeFlag);
-                while (changeFlag && count++ < MAX_SUBSTITUTION_LEVEL)
-                {
-                    // Basic and Double Quote tokens can have variable substitutions
-                    //     Repeat as many times as needed until all recursive levels are done.
-                    //     Capped at a large level to prevent INFINITE LOOP!
-                    char* previousExpansion = expandedToken;
-                    expandedToken = preprocess(previousExpansion, &changeFlag);
-                    free(previousExpansion);  // Free up old expanded token.
-                }
+                // Basic and Double Quote tokens can have variable substitutions
+                //     All recursive levels are done in this one call.
+                //     (Not PARALLEL's arguments - it expands them again for each item, see parallel.h)
+                int changeFlag;
+                expandedToken = preprocess(varList, answer.start, &changeFlag, &statementArena);
             }
             else
             {
-                // Otherwise just duplicate the token
-                expandedToken = strdup(answer.start);
+                // Otherwise just use the token (right in the line)
+                expandedToken = answer.start;
             }
 
-            /*  ioFlag will be 1 whenever there is a <, >, or >& detected.
-             *  The two flags were used to make sure that my code worked when multiple redirects
-             *  were in the same line, such as "cat < test.in | grep "Rawr!" | tr [a-z] [A-Z] >& test.err > test.out"
-             *
-             *  Each will allocate space and store the file name in the correct variable, clean up expandedToken, and reset appropriate flags.
-             */
-
-            if(inputFlag == 1 && ioFlag == 1) // If a < was detected.
-            {
-                input = malloc(sizeof(char) * (MAX_LINE_LENGTH + 1) );
-                strcpy(input, expandedToken);
-                free(expandedToken);
-                expandedToken = NULL;
-                inputFlag = 0;
-                ioFlag = 0; // ioFlag has to be reset as well, gave errors otherwise.
-                break;
-            }
-            else if(outputFlag == 1 && ioFlag == 1) // If a > was detected.
-            {
-                output = malloc(sizeof(char) * (MAX_LINE_LENGTH + 1) );
-                strcpy(output, expandedToken);
-                free(expandedToken);
-                expandedToken = NULL;
-                ioFlag = 0;
-                break;
-            }
-            else if(errorFlag == 1 && ioFlag == 1) // If a >& was detected.
+            if (redirect != NONE)
             {
-                error = malloc(sizeof(char) * (MAX_LINE_LENGTH + 1) );
-                strcpy(error, expandedToken);
-                free(expandedToken);
-                expandedToken = NULL;
-                ioFlag = 0;
-                break;
+                // The file name for the <, > or >& just before it.
+                //    (The last one given is used, if there are more.)
+                if (redirect == IN_FILE) cmd->inFile = expandedToken;
+                else if (redirect == ERR_FILE) cmd->errFile = expandedToken;
+                else
+                {
+                    cmd->outFile = expandedToken;
+                    cmd->append = (redirect == APPEND_FILE);
+                }
+                redirect = NONE;
             }
-
-            if (processMode == CMD)
+            else if (processMode == CMD && stmt->head == NULL && answer.type == BASIC &&
+                     (strcasecmp(expandedToken, "TIME") == 0 ||
+                      (stmt->timed == TIME_TEXT && strcasecmp(expandedToken, "-m") == 0)))
             {
-                // This is a new command
-                assert(cmd == NULL);
-                cmd = newCommand(expandedToken);
-                processMode = ARGS; // Switch modes
+                // TIME [-m] in front of the statement (see timing.h)
+                stmt->timed = (stmt->timed == NOT_TIMED) ? TIME_TEXT : TIME_MACHINE;
             }
-            else if (processMode == PIPED_CMD)
+            else if (processMode == CMD || processMode == PIPED_CMD)
             {
-                // This is a new command after a pipe
+                // This is a new command (after a pipe if PIPED_CMD)
+                //    The command borrows expandedToken (from line or arena)
+                Command* piped = cmd;
                 cmd = newCommand(expandedToken);
-                cmd->input = PIPE_IN;
+                if (processMode == PIPED_CMD)
+                {
+                    cmd->input = PIPE_IN;
+                    piped->reader = cmd;
+                }
+                addCommand(stmt, cmd);
                 processMode = ARGS; // Switch modes
             }
-            else if (processMode == ARGS)
+            else
             {
                 // This is a new argument
                 assert(cmd != NULL);
                 addArg(cmd, expandedToken, answer.type);
             }
-            free(expandedToken);  // Don't forget - we OWN this REFERENCE
             expandedToken = NULL;
             break;
 
         case PIPE:
-            // We have a pipe, so command is now completed and ready to be executed
+            // We have a pipe, so the command is now complete
             if (processMode == CMD || processMode == PIPED_CMD)
             {
                 // A pipe while waiting for a command!
                 // Empty (blank) statements for pipes are not allowed
-                fprintf(stderr, "Error: Missing command\n");
-                assert(cmd == NULL); // Otherwise some programming error occurred! (Mem leak maybe?)
+                statementError("Error: Missing command");
                 return;
             }
-            else
+            else if (redirect != NONE)
             {
-                assert(cmd != NULL); // Otherwise some prog. error - entered ARGS mode w/o a Command!
-                cmd->output = PIPE_OUT;
-                processCommand(cmd);
-                freeCommand(cmd);
-                processMode = PIPED_CMD; // Next command uses a piped command
+                statementError("Error: Missing file name for redirect");
+                return;
             }
+            assert(cmd != NULL); // Otherwise some prog. error - entered ARGS mode w/o a Command!
+            cmd->output = PIPE_OUT;
+            processMode = PIPED_CMD; // Next command uses a piped command
             break;
 
         case INPUT:
-            // Redirects input to a file.
-            inputFlag = 1;
-            ioFlag = 1;
-            cmd->input = IFILE;
-            break;
-
         case OUTPUT:
-            // Redirects output to a file.
-            outputFlag = 1;
-            ioFlag = 1;
-            cmd->output = OFILE;
-            break;
-
+        case APPEND:
         case ERR_REDIR:
-            // Redirects error to a file.
-            errorFlag = 1;
-            ioFlag = 1;
-            cmd->output = ERRFILE;
+            // Redirects input, output or error (of the current command) to a file.
+            if (processMode != ARGS)
+            {
+                statementError("Error: Missing command");
+                return;
+            }
+            else if (redirect != NONE)
+            {
+                statementError("Error: Missing file name for redirect");
+                return;
+            }
+            redirect = (answer.type == INPUT) ? IN_FILE : (answer.type == OUTPUT) ? OUT_FILE :
+                       (answer.type == APPEND) ? APPEND_FILE : ERR_FILE;
             break;
 
         case EOL:
@@ -281,13 +254,24 @@ void processLine(char* line)
             doneFlag = 1;
 
         case SEMICOLON:
-            // We have a statement terminator
+        case BACKGROUND:
+            // We have a statement terminator (& runs it in the background)
             if (processMode == PIPED_CMD)
             {
                 // We are in a piped command mode (without having gotten any new command)
                 // An empty statement - not allowed after a pipe
-                fprintf(stderr, "Error: Broken pipe\n");
-                assert(cmd == NULL);
+                statementError("Error: Broken pipe");
+                return;
+            }
+            else if (redirect != NONE)
+            {
+                statementError("Error: Missing file name for redirect");
+                return;
+            }
+            else if (processMode == CMD && stmt->timed != NOT_TIMED)
+            {
+                // TIME with nothing to time
+                statementError("Error: Missing command after TIME");
                 return;
             }
             else if (processMode == CMD)
@@ -297,45 +281,42 @@ void processLine(char* line)
             }
             else
             {
-                assert(cmd != NULL);
-                int child = processCommand(cmd);
-                freeCommand(cmd);
-                cmd = NULL;
-                if (child != 0)
-                {
-                    // Wait for the child to finish
-                    waitpid(child, &status, 0);
-                    if(sFlag == 1) fprintf(stderr, ">> Done: Exit %d\n", status);
-                }
-                else
-                {
-                    if(sFlag == 1) fprintf(stderr, ">> Done: Exit %d\n", 0);
-                }
+                // The statement is complete - run it
+                traceEvent("parse", parseStart, stmt->head->cmd->command, 0);
+                double runStart = traceClock();
+                processStatement(stmt, answer.type == BACKGROUND);
+                traceEvent("run", runStart, stmt->head->cmd->command, 0);
             }
 
             processMode = CMD; // Switch back to processing mode.
-
-            inputFlag = 0;     // Resets all redirect flags to 0.
-            outputFlag = 0;
-            errorFlag = 0;
-            ioFlag = 0;
-
+            cmd = NULL;
+            resetArena(&statementArena);  // Frees the statement (and expanded tokens)
+            stmt = newStatement();
+            parseStart = traceClock();
             break;
 
         default:
-            fprintf(stderr, "Programming Error: Unrecognized type returned!!!\n");
-            if (cmd != NULL)
-            {
-                freeCommand(cmd);
-                cmd = NULL;
-            }
+            statementError("Programming Error: Unrecognized type returned!!!");
             return;
         }
-        answer = getNextToken();
+        answer = nextToken(&tokenizer);
     }
 
     // Should only happen once doneFlag is set and SEMICOLON process is executed
     assert(cmd == NULL);
+    freeTokenizer(&tokenizer);
+}
+
+/***
+ * printExitStats:
+ *    Reports the shell's counters on stderr (at exit, if the TECHSHELL_STATS
+ *    environment variable is set) - see stats.h.
+ ***/
+static pid_t shellPid;
+static void printExitStats()
+{
+    if (getpid() != shellPid) return;   // Not from a child that failed to exec
+    printStats(stderr, &statementArena);
 }
 
 /***
@@ -345,28 +326,27 @@ void processLine(char* line)
 
 void printPrompt()
 {
-    findDir();
     printf("%s$$ ", dir);
+    fflush(stdout);  // (Input is not read through stdio, which would flush it)
 }
 
 int main(int argc, char *argv[])
 {
     varList = createVarSet();       // List of variables.
     sFlag = 0;                      // Whether status printing is turned on.
-    t = malloc(1 * sizeof(char));   // Array for "~", used for pwd and findDir.
-    t = "~";
     findDir();                      // Finds the current directory for displaying in the prompt.
     int interactiveFlag = 0;        // Whether we are in interactive mode or not.
-    FILE* inStream;                 // File stream for a potential file passed as an argument.
-    ioFlag = 0;                     // Redirect flags.
-    inputFlag = 0;
-    outputFlag = 0;
-    errorFlag = 0;
+    int inStream;                   // File (descriptor) for a potential file passed as an argument.
+    initArena(&statementArena);
+    initJobs();                     // Background jobs are reaped on SIGCHLD.
+    shellPid = getpid();
+    initTrace();                    // If TECHSHELL_TRACE is set (see trace.h)
+    if (getenv("TECHSHELL_STATS") != NULL) atexit(printExitStats);
 
     if (argc <= 1)
     {
         // No arguments given (in interactive mode)
-        inStream = stdin;
+        inStream = STDIN_FILENO;
         interactiveFlag = 1;
     }
     else
@@ -374,9 +354,9 @@ int main(int argc, char *argv[])
         // Argument 1 is the script to run (non-interactive mode)
         interactiveFlag = 0;
         int localErr;
-        inStream = fopen(argv[1], "r");
+        inStream = open(argv[1], O_RDONLY | O_CLOEXEC);  // (Not passed on to commands)
         localErr = errno;
-        if (inStream == NULL)
+        if (inStream < 0)
         {
             // Unable to open the file
             fprintf(stderr, "Error: %s\n", strerror(localErr));
@@ -386,7 +366,15 @@ int main(int argc, char *argv[])
 
     varList = createVarSet();
 
-    char line[MAX_LINE_LENGTH+1];
+    LineReader reader;              // Lines of any length (see lineReader.h)
+    char* useMap = getenv("TECHSHELL_MMAP");
+    if (interactiveFlag || (useMap != NULL && strcmp(useMap, "0") == 0) ||
+        !mapLineReader(&reader, inStream))
+    {
+        // Streamed (stdin, pipes, or mapping turned off)
+        initLineReader(&reader, inStream);
+    }
+    char* line;
 
     if (interactiveFlag != 0)
     {
@@ -394,7 +382,7 @@ int main(int argc, char *argv[])
         printPrompt();
     }
 
-    while (fgets(line, MAX_LINE_LENGTH+1, inStream) != NULL)
+    while ((line = readLine(&reader, NULL)) != NULL)
     {
         // We have our current line
         processLine(line);
@@ -406,5 +394,6 @@ int main(int argc, char *argv[])
         }
     }
 
+    freeLineReader(&reader);
     return 0;
 }
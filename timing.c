@@ -0,0 +1,103 @@
+/*******
+ * Dillon Welch
+ *
+ * Timing:
+ *    See timing.h for details.
+ *******/
+
+#include "timing.h"
+#include <string.h>
+#include <time.h>
+
+/***
+ * wallClock:
+ *    Seconds on a clock that only goes forward (for measuring time taken).
+ ***/
+double wallClock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double seconds(struct timeval time)
+{
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+/***
+ * usageSince:
+ *    What the shell itself has used since before (from getrusage) - for a
+ *    command it ran itself.  The resident size is the shell's.
+ ***/
+void usageSince(const struct rusage* before, struct rusage* usage)
+{
+    struct rusage now;
+    getrusage(RUSAGE_SELF, &now);
+    memset(usage, 0, sizeof(*usage));
+    timersub(&now.ru_utime, &before->ru_utime, &usage->ru_utime);
+    timersub(&now.ru_stime, &before->ru_stime, &usage->ru_stime);
+    usage->ru_maxrss = now.ru_maxrss;
+    usage->ru_nvcsw = now.ru_nvcsw - before->ru_nvcsw;
+    usage->ru_nivcsw = now.ru_nivcsw - before->ru_nivcsw;
+}
+
+/***
+ * printLine:
+ *    One line of the report (stage is 0 for the whole statement).
+ ***/
+static void printLine(FILE* stream, int machine, int stage, const char* command, double wall,
+                      const struct rusage* usage, int exit)
+{
+    if (machine)
+    {
+        if (stage > 0) fprintf(stream, "time stage=%d command=%s", stage, command);
+        else fprintf(stream, "time stage=all command=-");
+        fprintf(stream, " wall=%.6f user=%.6f sys=%.6f maxrss=%ld nvcsw=%ld nivcsw=%ld exit=%d\n",
+                wall, seconds(usage->ru_utime), seconds(usage->ru_stime), usage->ru_maxrss,
+                usage->ru_nvcsw, usage->ru_nivcsw, exit);
+        return;
+    }
+
+    char name[24];
+    if (stage > 0) snprintf(name, sizeof(name), "%d %s", stage, command);
+    else snprintf(name, sizeof(name), "all");
+    fprintf(stream, "%-20s %9.3fs %9.3fs %9.3fs %9ldK %7ld %7ld %5d\n", name, wall,
+            seconds(usage->ru_utime), seconds(usage->ru_stime), usage->ru_maxrss,
+            usage->ru_nvcsw, usage->ru_nivcsw, exit);
+}
+
+/***
+ * printTimes:
+ *    The TIME report for the statement: a line for each command, then one
+ *    for all of it (see timing.h).
+ *    times: one for each command (REFERENCE is BORROWED)
+ ***/
+void printTimes(FILE* stream, Statement* stmt, StageTime* times, double start, double end)
+{
+    int machine = (stmt->timed == TIME_MACHINE);
+    if (!machine)
+    {
+        fprintf(stream, "%-20s %10s %10s %10s %10s %7s %7s %5s\n", "TIME", "wall", "user", "sys",
+                "maxrss", "vcsw", "ivcsw", "exit");
+    }
+
+    struct rusage total;
+    memset(&total, 0, sizeof(total));
+    CmdList* curr;
+    int i;
+    for (curr = stmt->head, i = 0; curr != NULL; curr = curr->next, i++)
+    {
+        struct rusage* usage = &times[i].usage;
+        printLine(stream, machine, i + 1, curr->cmd->command, times[i].end - times[i].start, usage,
+                  exitCode(times[i].waitStatus));
+
+        timeradd(&total.ru_utime, &usage->ru_utime, &total.ru_utime);
+        timeradd(&total.ru_stime, &usage->ru_stime, &total.ru_stime);
+        if (usage->ru_maxrss > total.ru_maxrss) total.ru_maxrss = usage->ru_maxrss;
+        total.ru_nvcsw += usage->ru_nvcsw;
+        total.ru_nivcsw += usage->ru_nivcsw;
+    }
+    printLine(stream, machine, 0, NULL, end - start, &total, exitCode(times[i - 1].waitStatus));
+    fflush(stream);
+}
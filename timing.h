@@ -0,0 +1,50 @@
+/*******
+ * Dillon Welch
+ *
+ * Timing:
+ *    What TIME reports about a statement.
+ *
+ *       TIME [-m] statement
+ *
+ *    runs the statement, then prints (to standard error) for each command
+ *    in it: wall time, user and system CPU time, maximum resident size and
+ *    the number of voluntary and involuntary context switches, followed by
+ *    a line for the whole statement (wall time from start to finish, the
+ *    CPU times and context switches added up, the largest resident size).
+ *
+ *    The numbers for a launched command are its own (wait4's rusage).  A
+ *    command the shell runs itself (a builtin, or see fastPath.h) gets what
+ *    the shell used while running it - its resident size is the shell's.
+ *    A command's wall time runs until it is reaped (in pipeline order).
+ *
+ *    With -m each line is instead "key=value" pairs for scripts to read:
+ *       time stage=1 command=sort wall=0.012345 user=0.010000 sys=0.001000 maxrss=2048 nvcsw=3 nivcsw=1 exit=0
+ *       time stage=all command=- wall=...
+ *    (times in seconds, maxrss in kilobytes.)
+ *
+ *    TIME (like the builtins) and -m can be in any case.  TIME with no
+ *    statement after it is an error.  A statement run in the background
+ *    is not timed.
+ *******/
+
+#ifndef __TIMING_H
+#define __TIMING_H
+
+#include "command.h"
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+typedef struct
+{
+    double start;          // Wall clock when it was started (seconds)
+    double end;            // ... and when it was done
+    struct rusage usage;   // What it used
+    int waitStatus;
+} StageTime;
+
+double wallClock();
+void usageSince(const struct rusage* before, struct rusage* usage);
+void printTimes(FILE* stream, Statement* stmt, StageTime* times, double start, double end);
+
+#endif
@@ -5,9 +5,9 @@
  *
  * Tokenizer:
  *    This collection of functions takes as input a single line of text
- *    and tokenizes that text.  Each call to getNextToken() returns the
- *    next token (as a string) in the line.  If the line is complete a
- *    NULL is returned.
+ *    and tokenizes that text.  Each call to getNextToken() (or nextToken())
+ *    returns the next token (as a string) in the line.  If the line is
+ *    complete a NULL is returned.
  *
  * See Tokenizer.h for details.
  *******/
@@ -16,9 +16,170 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
-static char* tokLine = NULL;
-static char* currTokPos;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOKENIZER_SIMD
+#include <immintrin.h>
+#endif
+
+static char* tokLine = NULL;             // startToken's copy of the line
+static Tokenizer defaultTokenizer;      // Used by startToken/getNextToken
+
+/***
+ * Delimiter scanning
+ *    scanBasic: returns the first ' ', '\t', '\n' or '\0' at or after p.
+ *    scanQuote: returns the first quote or '\0' at or after p.
+ *
+ *    The SIMD versions only ever load whole aligned 16 (or 32) byte blocks.
+ *    An aligned block never crosses a page, so reading the bytes around the
+ *    terminating '\0' is safe even though they are not part of the string.
+ ***/
+static char* scanBasicScalar(char* p)
+{
+    while (*p != ' ' && *p != '\t' && *p != '\n' && *p != '\0') p++;
+    return p;
+}
+
+static char* scanQuoteScalar(char* p, char quote)
+{
+    while (*p != quote && *p != '\0') p++;
+    return p;
+}
+
+#ifdef TOKENIZER_SIMD
+static char* scanBasicSSE2(char* p)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    uintptr_t offset = (uintptr_t) p & 15;
+    char* block = p - offset;
+    unsigned int mask = 0xFFFFu << offset;  // Ignore bytes before p in the first block
+
+    for (;; block += 16, mask = 0xFFFFu)
+    {
+        __m128i v = _mm_load_si128((const __m128i*) block);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, zero)));
+        mask &= _mm_movemask_epi8(hit);
+        if (mask != 0) return block + __builtin_ctz(mask);
+    }
+}
+
+static char* scanQuoteSSE2(char* p, char quote)
+{
+    const __m128i q = _mm_set1_epi8(quote);
+    const __m128i zero = _mm_setzero_si128();
+    uintptr_t offset = (uintptr_t) p & 15;
+    char* block = p - offset;
+    unsigned int mask = 0xFFFFu << offset;
+
+    for (;; block += 16, mask = 0xFFFFu)
+    {
+        __m128i v = _mm_load_si128((const __m128i*) block);
+        mask &= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, zero)));
+        if (mask != 0) return block + __builtin_ctz(mask);
+    }
+}
+
+__attribute__((target("avx2")))
+static char* scanBasicAVX2(char* p)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    uintptr_t offset = (uintptr_t) p & 31;
+    char* block = p - offset;
+    unsigned int mask = 0xFFFFFFFFu << offset;
+
+    for (;; block += 32, mask = 0xFFFFFFFFu)
+    {
+        __m256i v = _mm256_load_si256((const __m256i*) block);
+        __m256i hit = _mm256_or_si256(
+                          _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+                          _mm256_or_si256(_mm256_cmpeq_epi8(v, newline), _mm256_cmpeq_epi8(v, zero)));
+        mask &= (unsigned int) _mm256_movemask_epi8(hit);
+        if (mask != 0) return block + __builtin_ctz(mask);
+    }
+}
+
+__attribute__((target("avx2")))
+static char* scanQuoteAVX2(char* p, char quote)
+{
+    const __m256i q = _mm256_set1_epi8(quote);
+    const __m256i zero = _mm256_setzero_si256();
+    uintptr_t offset = (uintptr_t) p & 31;
+    char* block = p - offset;
+    unsigned int mask = 0xFFFFFFFFu << offset;
+
+    for (;; block += 32, mask = 0xFFFFFFFFu)
+    {
+        __m256i v = _mm256_load_si256((const __m256i*) block);
+        mask &= (unsigned int) _mm256_movemask_epi8(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, zero)));
+        if (mask != 0) return block + __builtin_ctz(mask);
+    }
+}
+#endif
+
+static char* (*scanBasic)(char* p) = NULL;
+static char* (*scanQuote)(char* p, char quote) = NULL;
+
+/***
+ * tokenizerUseSimd:
+ *    Selects the delimiter scanning (see tokenizer.h).
+ ***/
+const char* tokenizerUseSimd(int enable)
+{
+    scanBasic = scanBasicScalar;
+    scanQuote = scanQuoteScalar;
+#ifdef TOKENIZER_SIMD
+    if (enable)
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            scanBasic = scanBasicAVX2;
+            scanQuote = scanQuoteAVX2;
+            return "avx2";
+        }
+        scanBasic = scanBasicSSE2;   // Every x86-64 has SSE2
+        scanQuote = scanQuoteSSE2;
+        return "sse2";
+    }
+#endif
+    return "scalar";
+}
+
+/***
+ * initTokenizer:
+ *    Start tokenizing line in place (see tokenizer.h).
+ ***/
+void initTokenizer(Tokenizer* tok, char* line)
+{
+    if (scanBasic == NULL)
+    {
+        // First line: pick the fastest delimiter scan for this CPU
+        tokenizerUseSimd(1);
+    }
+
+    tok->line = line;
+    tok->pos = line;
+}
+
+/***
+ * freeTokenizer:
+ *    Done with the tokenizer.  The line is the caller's, so nothing is freed;
+ *    the tokenizer just forgets it (and returns EOL from now on).
+ ***/
+void freeTokenizer(Tokenizer* tok)
+{
+    tok->line = NULL;
+    tok->pos = NULL;
+}
 
 void startToken(char* line)
 {
@@ -37,20 +198,30 @@ void startToken(char* line)
         // Not enough memory???
         fprintf(stderr, "ERROR: Insufficient memory to tokenize!  Using empty space.\n");
         tokLine = NULL;
-        currTokPos = NULL;
+        initTokenizer(&defaultTokenizer, NULL);
         return;
     }
 
     strcpy(tokLine, line);
 
-    // Start the token pointing to the first position
-    currTokPos = tokLine;
+    // Tokenize the copy (in place)
+    initTokenizer(&defaultTokenizer, tokLine);
 }
 
 aToken getNextToken()
+{
+    return nextToken(&defaultTokenizer);
+}
+
+/***
+ * nextToken:
+ *    See tokenizer.h (this is where the actual tokenizing is done).
+ ***/
+aToken nextToken(Tokenizer* tok)
 {
     aToken res;
-    if (currTokPos == NULL || *currTokPos == '\0')
+    res.length = 0;
+    if (tok->pos == NULL || *tok->pos == '\0')
     {
         // End of line reached.  (Nothing left to parse)
         res.type = EOL;
@@ -59,12 +230,12 @@ aToken getNextToken()
     }
 
     // Find the first non-white space
-    while (*currTokPos == ' ' ||
-            *currTokPos == '\t' ||
-            *currTokPos == '\n')
-        currTokPos++;
+    while (*tok->pos == ' ' ||
+            *tok->pos == '\t' ||
+            *tok->pos == '\n')
+        tok->pos++;
 
-    switch (*currTokPos)
+    switch (*tok->pos)
     {
     case '\0':
         // We have reached the end of the line...
@@ -74,49 +245,52 @@ aToken getNextToken()
 
     case '\'':
         // We have a single quoted string
-        res.start = ++currTokPos;  // Skipping the quotes
+        res.start = ++tok->pos;  // Skipping the quotes
         res.type = SINGLE_QUOTE;   // Store type as SINGLE_QUOTE
 
         // Find end of token (using ' as delimiter)
-        while (*currTokPos != '\'' &&
-                *currTokPos != '\0') currTokPos++;
+        tok->pos = scanQuote(tok->pos, '\'');
         break;
 
     case '\"':
         // We have a double quoted string
-        res.start = ++currTokPos;  // Skipping the quotes
+        res.start = ++tok->pos;  // Skipping the quotes
         res.type = DOUBLE_QUOTE;   // Store type as DOUBLE_QUOTE
 
-        // Find end of token (using ' as delimiter)
-        while (*currTokPos != '\"' &&
-                *currTokPos != '\0') currTokPos++;
+        // Find end of token (using " as delimiter)
+        tok->pos = scanQuote(tok->pos, '\"');
         break;
 
     case '|':
         // We have a pipe
         res.start = NULL;  // String is not needed
         res.type = PIPE;   // Store type as PIPE
-        ++currTokPos;      // Skip the pipe
+        ++tok->pos;      // Skip the pipe
         break;
 
     case '<':
         // Input redirection
         res.start = NULL;   // Storing is not needed.
         res.type = INPUT;   // Store type as INPUT.
-        ++currTokPos;       // Skip the redirect.
+        ++tok->pos;       // Skip the redirect.
         break;
 
     case '>':
         // Output redirection
         res.start = NULL;   // Storing is not needed.
         res.type = OUTPUT;  // Store type as OUTPUT.
-        ++currTokPos;       // Skip the redirect.
+        ++tok->pos;       // Skip the redirect.
 
         // If the next character is a &, this is for redirecting output.
-        if(*currTokPos == '&')
+        if(*tok->pos == '&')
         {
             res.type = ERR_REDIR;
-            ++currTokPos;
+            ++tok->pos;
+        }
+        else if(*tok->pos == '>')  // >> appends to the file instead.
+        {
+            res.type = APPEND;
+            ++tok->pos;
         }
         break;
 
@@ -124,7 +298,14 @@ aToken getNextToken()
         // We have a semicolon
         res.start = NULL;  // String is not needed
         res.type = SEMICOLON;  // Store type as SEMICOLON
-        ++currTokPos;      // Skip the semicolon
+        ++tok->pos;      // Skip the semicolon
+        break;
+
+    case '&':
+        // Run the statement in the background
+        res.start = NULL;  // String is not needed
+        res.type = BACKGROUND;  // Store type as BACKGROUND
+        ++tok->pos;      // Skip the &
         break;
 
     case '#': // Treats the # token and everything that follows it as an EOL
@@ -134,21 +315,22 @@ aToken getNextToken()
 
     default:
         // This is start of a basic string
-        res.start = currTokPos;
+        res.start = tok->pos;
         res.type = BASIC;
 
         // Find end of token (using regular delimiters)
-        while (*currTokPos != ' ' &&
-                *currTokPos != '\t' &&
-                *currTokPos != '\n' &&
-                *currTokPos != '\0')
-            currTokPos++;
+        tok->pos = scanBasic(tok->pos);
+    }
+
+    if (res.start != NULL)
+    {
+        res.length = tok->pos - res.start;
     }
 
-    if (*currTokPos != '\0')
+    if (*tok->pos != '\0')
     {
-        // Haven't quite reached the end (mark it - and advance currTokPos)
-        *(currTokPos++) = '\0';
+        // Haven't quite reached the end (mark it - and advance tok->pos)
+        *(tok->pos++) = '\0';
     }
     else if (res.type == SINGLE_QUOTE || res.type == DOUBLE_QUOTE)
     {
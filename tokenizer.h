@@ -39,20 +39,60 @@
  *    This is a very very simplistic tokenizer but will do for our basic needs
  *    for now.
  *
+ * Scanning:
+ *    The end of a BASIC or quoted token is found 32 (AVX2) or 16 (SSE2) bytes
+ *    at a time when the CPU supports it, otherwise one byte at a time.
+ *    Either way the tokens are exactly as described above.
+ *
  *******/
 
 #ifndef __TOKENIZER_H
 #define __TOKENIZER_H
 /***
- * A token: storing start of the token string
+ * A token: storing start of the token string, its length
  *  and the type of the token.
+ *  Together start and length are a span of the line being tokenized.
  ***/
 typedef struct
 {
     char *start;
-    enum { BASIC, SINGLE_QUOTE, DOUBLE_QUOTE, PIPE, SEMICOLON, EOL, INPUT, OUTPUT, ERR_REDIR, ERROR } type;
+    int length;   // strlen(start) (0 if there is no string)
+    enum { BASIC, SINGLE_QUOTE, DOUBLE_QUOTE, PIPE, SEMICOLON, EOL, INPUT, OUTPUT, APPEND, ERR_REDIR, BACKGROUND, ERROR } type;
 } aToken;
 
+/***
+ * A tokenizer: the state of tokenizing one line.
+ *    Any number of lines can be tokenized at once (one Tokenizer each).
+ ***/
+typedef struct
+{
+    char* line;  // The line being tokenized (REFERENCE is BORROWED - altered in place)
+    char* pos;   // Where the next token is searched for (in line)
+} Tokenizer;
+
+/***
+ * initTokenizer:
+ *    Start tokenizing the given line with tok.
+ *    No copy is made: the tokens returned by nextToken point into line itself,
+ *    and the end of each token is marked by writing a '\0' into line.
+ *    So line must stay (and not be changed by the caller) until tokenizing is done.
+ *    A NULL line is treated as an empty one.
+ ***/
+void initTokenizer(Tokenizer* tok, char* line);
+
+/***
+ * nextToken:
+ *    Return the next token in the line of tok (as getNextToken does below).
+ *    The token start stays valid as long as the line does.
+ ***/
+aToken nextToken(Tokenizer* tok);
+
+/***
+ * freeTokenizer:
+ *    Done with tok.  (The line belongs to the caller, so it is not freed.)
+ ***/
+void freeTokenizer(Tokenizer* tok);
+
 /***
  * startToken:
  *    Register the start of a new line to tokenize.
@@ -62,6 +102,8 @@ typedef struct
  *    line: A pointer to the start of the null-terminated string for this line.
  *          The string gets stored in a local copy so the string line can change
  *          without affecting the tokenizer.  Also, line is not altered in any way.
+ *
+ *    startToken/getNextToken tokenize that copy with a single shared Tokenizer.
  ***/
 void startToken(char *line);
 
@@ -80,7 +122,9 @@ void startToken(char *line);
  *      SEMICOLON: If token is ';'
  *      INPUT: If token is '<'
  *      OUTPUT: If token is '>'
+ *      APPEND: If token is '>>'
  *      ERR_REDIR: If token is '>&'
+ *      BACKGROUND: If token is '&'
  *
  *    Returns aToken.start:
  *      If not EOL or ERROR, then start points to start of the string
@@ -94,4 +138,13 @@ void startToken(char *line);
  ***/
 aToken getNextToken();
 
+/***
+ * tokenizerUseSimd:
+ *    Picks how delimiters are scanned: the fastest SIMD version this CPU
+ *    supports if enable is nonzero, or the plain byte-at-a-time loop if not.
+ *    (startToken picks the fastest on its first call if this was never called.)
+ *    Returns the name of the version picked ("avx2", "sse2" or "scalar").
+ ***/
+const char* tokenizerUseSimd(int enable);
+
 #endif  /* __TOKENIZER_H */
@@ -0,0 +1,194 @@
+/*******
+ * Dillon Welch
+ *
+ * Trace:
+ *    See trace.h for details.
+ *
+ *    Events are put in a buffer and written out when it fills (and at
+ *    exit), so tracing does not cost a write for every event.  Each event
+ *    ends with a comma; the last one, written at exit, closes the array.
+ *******/
+
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int tracing = 0;
+
+static int traceFd = -1;
+static int tracePid;          // The shell (not a forked child)
+static char buffer[1 << 16];  // Events not written yet
+static size_t used = 0;
+
+/***
+ * flushTrace:
+ *    Writes out the buffered events.
+ ***/
+static void flushTrace()
+{
+    size_t done = 0;
+    while (done < used)
+    {
+        ssize_t wrote = write(traceFd, buffer + done, used - done);
+        if (wrote == -1 && errno == EINTR) continue;
+        if (wrote <= 0) break;   // (The trace is lost, the shell goes on)
+        done += wrote;
+    }
+    used = 0;
+}
+
+/***
+ * addEvent:
+ *    Adds the (printf formatted) event to the buffer.
+ ***/
+static void addEvent(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer + used, sizeof(buffer) - used, format, args);
+    va_end(args);
+    if (length >= (int) (sizeof(buffer) - used))
+    {
+        // Did not fit - make room, and do it again
+        flushTrace();
+        va_start(args, format);
+        length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+    }
+    if (length > 0) used += length;
+}
+
+/***
+ * escape:
+ *    The text, as the inside of a JSON string (cut short if it is long).
+ *    Returns out.
+ ***/
+static char* escape(const char* text, char* out, size_t size)
+{
+    size_t length = 0;
+    for (; *text != '\0' && length + 7 < size; text++)
+    {
+        unsigned char c = *text;
+        if (c == '"' || c == '\\')
+        {
+            out[length++] = '\\';
+            out[length++] = c;
+        }
+        else if (c < 0x20)
+        {
+            length += sprintf(out + length, "\\u%04x", c);
+        }
+        else
+        {
+            out[length++] = c;
+        }
+    }
+    out[length] = '\0';
+    return out;
+}
+
+/***
+ * finishTrace:
+ *    Closes the array and writes out the rest (at exit).
+ ***/
+static void finishTrace()
+{
+    if (getpid() != tracePid) return;   // Not from a child that failed to exec
+    addEvent("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"techShell\"}}\n]\n",
+             tracePid, tracePid);
+    flushTrace();
+    close(traceFd);
+    tracing = 0;
+}
+
+/***
+ * initTrace:
+ *    Starts tracing to the file named by TECHSHELL_TRACE (if it is set).
+ ***/
+void initTrace()
+{
+    const char* path = getenv("TECHSHELL_TRACE");
+    if (path == NULL || *path == '\0') return;
+
+    traceFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (traceFd == -1)
+    {
+        fprintf(stderr, "Warning: TECHSHELL_TRACE %s: %s\n", path, strerror(errno));
+        return;
+    }
+    tracing = 1;
+    tracePid = getpid();
+    addEvent("[\n");
+    flushTrace();   // (Before any forked child's exec mark)
+    atexit(finishTrace);
+}
+
+/***
+ * traceClock:
+ *    Now, in microseconds (0 when not tracing - it is not needed).
+ ***/
+double traceClock()
+{
+    if (!tracing) return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/***
+ * traceEvent:
+ *    An event on the shell's track, from start until now.
+ *    detail: what it was done for (or NULL)
+ *    pid: the command it was for (or 0)
+ ***/
+void traceEvent(const char* name, double start, const char* detail, int pid)
+{
+    if (!tracing) return;
+    double end = traceClock();
+    char text[256];
+    addEvent("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{",
+             name, start, end - start, tracePid, tracePid);
+    if (detail != NULL) addEvent("\"detail\":\"%s\"%s", escape(detail, text, sizeof(text)), pid > 0 ? "," : "");
+    if (pid > 0) addEvent("\"pid\":%d", pid);
+    addEvent("}},\n");
+}
+
+/***
+ * traceProcess:
+ *    The command's own track (named for it), with its life from start
+ *    (when it was launched) until now (when it was reaped).
+ ***/
+void traceProcess(const char* command, int pid, double start)
+{
+    if (!tracing) return;
+    double end = traceClock();
+    char text[256];
+    addEvent("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%d %s\"}},\n",
+             tracePid, pid, pid, escape(command, text, sizeof(text)));
+    addEvent("{\"name\":\"process\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"detail\":\"%s\"}},\n",
+             start, end - start, tracePid, pid, text);
+}
+
+/***
+ * traceExec:
+ *    Marks a forked child (on its own track) about to exec the command.
+ *    It is written right away (the child's copy of the buffer is never
+ *    written out, and the file is appended to, so it can not overwrite the
+ *    shell's events).
+ ***/
+void traceExec(const char* command)
+{
+    if (!tracing) return;
+    char text[256];
+    char event[512];
+    int length = snprintf(event, sizeof(event),
+                          "{\"name\":\"exec\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"detail\":\"%s\"}},\n",
+                          traceClock(), tracePid, (int) getpid(), escape(command, text, sizeof(text)));
+    if (length > 0 && length < (int) sizeof(event)) write(traceFd, event, length);
+}
@@ -0,0 +1,42 @@
+/*******
+ * Dillon Welch
+ *
+ * Trace:
+ *    A trace of what the shell spends its time on, for chrome://tracing or
+ *    Perfetto (ui.perfetto.dev).
+ *
+ *       TECHSHELL_TRACE=file techShell script
+ *
+ *    writes the events to file, in the Chrome trace (JSON array) format.
+ *    Timestamps are microseconds on the monotonic clock.  On the shell's
+ *    own track:
+ *       parse      tokenizing a statement and building its Commands
+ *       expand     one variable substitution (nested in parse)
+ *       run        the whole statement, from the first launch to the last reap
+ *       spawn      launching a command with posix_spawn (the exec is done
+ *                  by the time it returns) - or fork, with SPAWN fork
+ *       builtin    a builtin run by the shell
+ *       fastpath   echo/cat/true/false run by the shell (see fastPath.h)
+ *       wait       waiting for a command of the statement to be reaped
+ *    and each launched command gets a track of its own (named with its pid
+ *    and command) with a "process" event from its launch to its reap, and,
+ *    with SPAWN fork, an "exec" mark written by the child just before it
+ *    execs.  So a pipeline whose commands were not running at the same
+ *    time shows up as process events one after the other.
+ *
+ *    When the variable is not set nothing is traced, and each trace point
+ *    costs a test of tracing.
+ *******/
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+extern int tracing;   // Whether the shell is being traced (TECHSHELL_TRACE)
+
+void initTrace();
+double traceClock();
+void traceEvent(const char* name, double start, const char* detail, int pid);
+void traceProcess(const char* command, int pid, double start);
+void traceExec(const char* command);
+
+#endif
@@ -8,111 +8,306 @@
  *******/
 
 #include "varSet.h"
+#include "expand.h"
+#include "stats.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+#define INITIAL_BUCKETS 16     // Must be a power of 2.
+#define INITIAL_ENTRIES 8
+
+/***
+ * hashString:
+ *    FNV-1a hash of the first length characters of s.
+ ***/
+unsigned int hashString(const char* s, size_t length)
+{
+    unsigned int hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) s[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/***
+ * findBucket:
+ *    Probes the table for name (length characters, with the given hash).
+ *    Returns the bucket holding name, or the empty bucket where it belongs.
+ ***/
+static VarBucket* findBucket(VarSet* set, const char* name, size_t length, unsigned int hash)
+{
+    unsigned int i = hash & set->mask;
+    unsigned long probes = 1;
+    while (set->buckets[i].slot != -1)
+    {
+        const char* other = set->entries[set->buckets[i].slot].name;
+        if (set->buckets[i].hash == hash &&
+                strncmp(name, other, length) == 0 && other[length] == '\0')
+        {
+            // Found it
+            break;
+        }
+        i = (i + 1) & set->mask;
+        probes++;
+    }
+    stats.lookups++;
+    stats.probes += probes;
+    if (probes > stats.longestProbe) stats.longestProbe = probes;
+    return &set->buckets[i];
+}
+
+/***
+ * growBuckets:
+ *    Doubles the number of buckets and re-inserts every entry.
+ *    The hashes are stored so no name is rehashed or compared.
+ ***/
+static void growBuckets(VarSet* set)
+{
+    unsigned int size = (set->mask + 1) * 2;
+    free(set->buckets);
+    set->buckets = malloc(size * sizeof(VarBucket));
+    set->mask = size - 1;
+
+    unsigned int i;
+    for (i = 0; i < size; i++) set->buckets[i].slot = -1;
+
+    int e;
+    for (e = 0; e < set->count; e++)
+    {
+        i = set->entries[e].hash & set->mask;
+        while (set->buckets[i].slot != -1) i = (i + 1) & set->mask;
+        set->buckets[i].hash = set->entries[e].hash;
+        set->buckets[i].slot = e;
+    }
+}
+
+/***
+ * addSlot:
+ *    Adds a new (not yet set) entry for name to the empty bucket.
+ *    Returns its slot.
+ ***/
+static int addSlot(VarSet* set, VarBucket* bucket, const char* name, size_t length,
+                   unsigned int hash)
+{
+    if (set->count == set->capacity)
+    {
+        set->capacity *= 2;
+        set->entries = realloc(set->entries, set->capacity * sizeof(VarEntry));
+        set->order = realloc(set->order, set->capacity * sizeof(int));
+    }
+
+    int slot = set->count++;
+    VarEntry* locate = &set->entries[slot];
+    locate->name = strndup(name, length);
+    locate->value = NULL;
+    locate->hash = hash;
+    locate->tmpl = NULL;
+    locate->expansion = NULL;
+    locate->expansionLength = 0;
+    locate->height = 0;
+    locate->memoGeneration = 0;
+    locate->expanding = 0;
+    locate->special = 0;
+    bucket->hash = hash;
+    bucket->slot = slot;
+
+    // Keep the table at most half full (so probes stay short)
+    if ((unsigned int) set->count * 2 > set->mask + 1) growBuckets(set);
+    return slot;
+}
+
 /***
  * createVarSet:
- *   Create a variable set (or one entry in the set)
+ *   Create an (empty) variable set
  ***/
 VarSet* createVarSet()
 {
     VarSet* ans = malloc(sizeof(VarSet));
-    ans->name = NULL;
-    ans->value = NULL;
-    ans->next = NULL;
+    ans->count = 0;
+    ans->capacity = INITIAL_ENTRIES;
+    ans->entries = malloc(ans->capacity * sizeof(VarEntry));
+    ans->order = malloc(ans->capacity * sizeof(int));
+    ans->defined = 0;
+    ans->mask = INITIAL_BUCKETS - 1;
+    ans->generation = 1;
+    ans->buckets = malloc(INITIAL_BUCKETS * sizeof(VarBucket));
+
+    int i;
+    for (i = 0; i < INITIAL_BUCKETS; i++) ans->buckets[i].slot = -1;
     return ans;
 }
 
 /***
  * freeVarSet:
- *    Free up the variable set (delete the linked list and contents)
+ *    Free up the variable set (the table and its contents)
  *    Must also free all OWNED references.
  ***/
 void freeVarSet(VarSet* set)
 {
-    VarSet* curr = set;
-    while (curr != NULL)
+    if (set == NULL) return;
+
+    clearTemplateCache();  // Cached templates refer to slots in this set.
+
+    int i;
+    for (i = 0; i < set->count; i++)
     {
-        if (curr->name != NULL) free(curr->name);
-        if (curr->value != NULL) free(curr->value);
-        VarSet* next = curr->next;
-        free(curr);
-        curr = next;
+        free(set->entries[i].name);
+        free(set->entries[i].value);
+        freeTemplate(set->entries[i].tmpl);
+        free(set->entries[i].expansion);
     }
+    free(set->entries);
+    free(set->order);
+    free(set->buckets);
+    free(set);
 }
 
 /***
  * addToSet:
  *    Add the given name/value to the set
  *    If name exists - replace with new value
- *    If not, add the name/value to the list
+ *    If not, add the name/value to the table
  ***/
 void addToSet(VarSet* set, char* name, char* value, int tokenType)
 {
-    assert(set != NULL);  // Using a dummy head node - so verify it is created.
+    assert(set != NULL);
 
     // First lookup variable (if already exists)
-    VarSet* locate = findInSet(set, name);
-    if (locate == NULL)
+    size_t length = strlen(name);
+    unsigned int hash = hashString(name, length);
+    VarBucket* bucket = findBucket(set, name, length, hash);
+    int slot = bucket->slot;
+    if (slot == -1)
     {
         // We have a new variable!
-        locate = createVarSet();
-        locate->name = strdup(name);
-        locate->value = strdup(value);
-        locate->next = set->next;
-        set->next = locate;
+        slot = addSlot(set, bucket, name, length, hash);
+    }
+
+    VarEntry* locate = &set->entries[slot];
+    if (locate->value == NULL)
+    {
+        // First time it is set
+        set->order[set->defined++] = slot;
     }
     else
     {
         // Replace
-        if (locate->value != NULL)
-        {
-            free(locate->value);
-        }
-        locate->value = strdup(value);
+        free(locate->value);
+        freeTemplate(locate->tmpl);
+        locate->tmpl = NULL;
     }
+    locate->value = strdup(value);
+    locate->special = 0;
+
+    // Any memoized expansion may have used the old value (or lack of one)
+    set->generation++;
+}
+
+/***
+ * addSpecialToSet:
+ *    Add (or replace) a variable set by the shell itself (see varSet.h).
+ ***/
+void addSpecialToSet(VarSet* set, char* name, char* value)
+{
+    addToSet(set, name, value, -1);
+    findInSet(set, name)->special = 1;
+}
+
+/***
+ * removeFromSet:
+ *    Unsets the variable (if it is set), as if it had never been SET.
+ *    Its slot stays reserved, since compiled templates may refer to it.
+ ***/
+void removeFromSet(VarSet* set, char* name)
+{
+    assert(set != NULL);
+
+    size_t length = strlen(name);
+    VarBucket* bucket = findBucket(set, name, length, hashString(name, length));
+    int slot = bucket->slot;
+    if (slot == -1 || set->entries[slot].value == NULL) return;
+
+    VarEntry* locate = &set->entries[slot];
+    free(locate->value);
+    locate->value = NULL;
+    freeTemplate(locate->tmpl);
+    locate->tmpl = NULL;
+    locate->special = 0;
+
+    // No longer listed (the order of the rest is kept)
+    int i;
+    for (i = 0; set->order[i] != slot; i++);
+    memmove(&set->order[i], &set->order[i + 1], (set->defined - i - 1) * sizeof(int));
+    set->defined--;
+
+    // Any memoized expansion may have used the old value
+    set->generation++;
 }
 
 /***
  * findInSet:
  *    Searches for a given name in the set
- *    Returns the reference in the list for the matching name
- *    or NULL if not found.
+ *    Returns the reference in the table for the matching name
+ *    or NULL if not found (or only reserved).
  *    Matching is case sensitive.
  ***/
-VarSet* findInSet(VarSet* set, char* name)
+VarEntry* findInSet(VarSet* set, char* name)
+{
+    return findNameInSet(set, name, strlen(name));
+}
+
+/***
+ * findNameInSet:
+ *    Same as findInSet, but the name is the first length characters
+ *    of the given string (so it need not be null-terminated).
+ ***/
+VarEntry* findNameInSet(VarSet* set, const char* name, size_t length)
 {
-    assert(set != NULL);   // Using a dummy head node - so verify it is created.
+    assert(set != NULL);
 
-    VarSet* curr;
-    for (curr = set->next; curr != NULL; curr = curr->next)
+    VarBucket* bucket = findBucket(set, name, length, hashString(name, length));
+    if (bucket->slot == -1 || set->entries[bucket->slot].value == NULL)
     {
-        if (strcmp(name, curr->name) == 0)
-        {
-            // Found it
-            return curr;
-        }
+        // Nothing found
+        return NULL;
     }
+    return &set->entries[bucket->slot];
+}
 
-    // Nothing found
-    return NULL;
+/***
+ * slotInSet:
+ *    Returns the slot for the name (the first length characters of the string).
+ *    If there is none yet, one is reserved (the variable is still not set).
+ ***/
+int slotInSet(VarSet* set, const char* name, size_t length)
+{
+    assert(set != NULL);
+
+    unsigned int hash = hashString(name, length);
+    VarBucket* bucket = findBucket(set, name, length, hash);
+    if (bucket->slot != -1) return bucket->slot;
+    return addSlot(set, bucket, name, length, hash);
 }
 
 /***
  * printSet:
  *    Print the given set to the stream
+ *    (Most recently added variables first, special ones left out)
  ***/
 void printSet(VarSet* set, FILE* stream)
 {
-    assert(set != NULL);   // Using a dummy head node - so verify it is created.
+    assert(set != NULL);
 
-    VarSet* curr;
-    for (curr = set->next; curr != NULL; curr = curr->next)
+    int i;
+    for (i = set->defined - 1; i >= 0; i--)
     {
+        VarEntry* curr = &set->entries[set->order[i]];
+        if (curr->special) continue;
         fprintf(stream, "%s: %s\n", curr->name, curr->value);
     }
 }
-
@@ -6,7 +6,21 @@
  * VarSet:
  *    Representing a set of variables
  *    Each entry in the set contains a name and value
- *    In our implementation this is a linked list (with dummy head node)
+ *    In our implementation this is an open-addressing hash table (linear probing)
+ *    over a dense array of entries.  Each bucket of the table stores the
+ *    precomputed hash of its name, so a lookup only touches an entry (and
+ *    compares names) when the full hash already matches.
+ *
+ *    Slots:
+ *       The index of an entry in the array is its slot, and it never changes.
+ *       A slot can be reserved for a name that is not set yet (its value is
+ *       NULL), so compiled templates (see expand.h) can refer to variables
+ *       by slot before they are SET.
+ *
+ *    Special variables:
+ *       Variables the shell sets itself (like PIPESTATUS) are added with
+ *       addSpecialToSet.  They expand like any other, but LIST does not
+ *       show them (unless they are SET by hand).
  *    Several functions are provided to access/use this set.
  *******/
 
@@ -15,17 +29,57 @@
 
 #include <stdio.h>
 
+struct template;
+
+typedef struct varEntry
+{
+    char* name;         // REFERENCE is OWNED
+    char* value;        // REFERENCE is OWNED (NULL if only reserved, not set)
+    unsigned int hash;  // Precomputed hash of name
+    struct template* tmpl;  // Compiled value (REFERENCE is OWNED, NULL until needed)
+
+    // Expansion memo (see expand.h), valid while memoGeneration matches the set.
+    char* expansion;               // Fully expanded value (REFERENCE is OWNED, may be NULL)
+    int expansionLength;           // strlen(expansion)
+    int height;                    // Substitution levels the expansion needed
+    unsigned long memoGeneration;  // Generation of the set when expansion was stored
+    int expanding;                 // Set while the value is being expanded (cycle detection)
+    int special;                   // Set by the shell itself, not SET (LIST does not show it)
+} VarEntry;
+
+typedef struct varBucket
+{
+    unsigned int hash;  // Hash of the name stored in this bucket
+    int slot;           // Index into entries (-1 if the bucket is empty)
+} VarBucket;
+
 typedef struct varSet
 {
-    char* name;   // REFERENCE is OWNED
-    char* value;  // REFERENCE is OWNED
-    struct varSet *next;  // REFERENCE is OWNED
+    VarEntry* entries;  // The variables, by slot (REFERENCE is OWNED)
+    int count;          // Number of slots in use
+    int capacity;       // Number of slots allocated
+    int* order;         // Slots of the set variables, in the order they were first SET (OWNED)
+    int defined;        // Number of slots in order
+    VarBucket* buckets; // The hash index over entries (REFERENCE is OWNED)
+    unsigned int mask;  // Number of buckets - 1 (number of buckets is a power of 2)
+    unsigned long generation;  // Bumped whenever any value changes (invalidates memos)
 } VarSet;
 
 VarSet* createVarSet();
 void freeVarSet(VarSet* set);
 void addToSet(VarSet* set, char* name, char* value, int tokenType);
-VarSet* findInSet(VarSet* set, char* name);
+void addSpecialToSet(VarSet* set, char* name, char* value);
+void removeFromSet(VarSet* set, char* name);
+
+/***
+ * findInSet:
+ *    The entry returned is BORROWED and only valid until the next addToSet
+ *    or slotInSet (adding a slot may move the entries).
+ ***/
+VarEntry* findInSet(VarSet* set, char* name);
+VarEntry* findNameInSet(VarSet* set, const char* name, size_t length);
+int slotInSet(VarSet* set, const char* name, size_t length);
 void printSet(VarSet* set, FILE* stream);
+unsigned int hashString(const char* s, size_t length);
 
 #endif